@@ -1,214 +1,2544 @@
 // Include the necessary headers
+#define _GNU_SOURCE // For recvmmsg and accept4
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <getopt.h>
+#include <time.h>
 #include <SDL2/SDL.h>
 #include <math.h> // Added math.h header
+#include "serial_config.h"
+
+// Define the vector types used by the persistence display
+typedef float f32x8 __attribute__((vector_size(32)));
+typedef int32_t i32x8 __attribute__((vector_size(32)));
+typedef uint16_t u16x16 __attribute__((vector_size(32)));
 
 // Define some constants
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 #define GRAPH_COLOR 0xFF0000FF // Red
 #define BACKGROUND_COLOR 0xFFFFFFFF // White
+#define PANEL_GAP_COLOR 0xC0C0C0FF // Light grey
 #define SLIDER_COLOR 0x000000FF // Black
 #define SLIDER_ACTIVE_COLOR 0x00FF00FF // Green
 #define SLIDER_WIDTH 20 // The width of each slider
 #define SLIDER_PADDING 10 // The padding between the sliders and the window edges
+#define PANEL_GAP 2 // The gap in pixels between neighbouring panels
+#define MAX_PANELS 64 // The maximum number of input sources (one panel each)
+#define INPUT_BUFFER 4096 // The size of the per-panel read and line buffer
+#define FRAME_INTERVAL 16 // The minimum time in milliseconds between two presents
+#define STATS_BAND_COLOR 0x0000FF30 // Translucent blue, the mean +/- one standard deviation band
+#define STATS_MEAN_COLOR 0x0000FFFF // Blue
+#define STATS_RMS_COLOR 0x008000FF // Dark green
+#define STATS_PERCENTILE_COLOR 0xFF8000FF // Orange, the p5 and p95 lines
+#define QUANTILE_BUCKET_BITS 16 // The number of leading bits of a sample's order-preserving key used as its histogram bucket
+#define QUANTILE_BUCKETS (1 << QUANTILE_BUCKET_BITS) // The number of buckets of the quantile histogram
+#define QUANTILE_GROUP 256 // The number of buckets summarized by one group count of the quantile histogram
+#define SPECTRUM_COLOR 0x0000C0FF // Dark blue
+#define SPECTRUM_RANGE_DB 100.0f // The dynamic range shown below the highest spectrum bin
+#define FFT_SIZE 1024 // The default number of samples per FFT
+#define FFT_MAX_SIZE 65536 // The largest supported FFT size
+#define FFT_RING_HOPS 16 // The number of hops of samples buffered between the ingest path and the FFT worker
+
+#define SERIAL_BAUD B9600 // The default serial port baud rate
+#define DGRAM_BATCH 64 // The number of datagrams received with one recvmmsg call
+#define DGRAM_SIZE 2048 // The largest datagram received without truncation
+#define SOCKET_RCVBUF (4 << 20) // The receive buffer size requested for datagram sockets
+#define TRACE_PENDING 64 // The number of batches of samples per panel whose latency is tracked until they are presented
+#define TRACE_BUCKETS 40 // The number of power-of-two latency histogram buckets, from 1 microsecond up
+#define MAX_STRIPS 16 // The largest number of vertical strips of the framebuffer rasterized in parallel
+#define GRID_COLOR 0xE0E0E0FF // Very light grey, the horizontal lines at the y axis ticks
+#define LABEL_COLOR 0x404040FF // Dark grey, the tick labels and the value readouts
+#define CURSOR_COLOR 0x808080FF // Grey, the vertical line under the mouse
+#define TICK_SPACING 40 // The smallest distance in pixels between two y axis ticks
+#define MAX_TICKS 32 // The largest number of y axis ticks of a panel
+#define TICK_LABEL 16 // The size of the buffer of a tick label
+#define FONT_WIDTH 6 // The width of a glyph cell of the embedded font, including one column of spacing
+#define FONT_HEIGHT 8 // The height of a glyph cell of the embedded font, including one row of spacing
+#define FONT_GLYPHS 24 // The number of glyphs of the embedded font
+#define ALARM_RAISED_COLOR 0xC000C0FF // Magenta, the marker of a raised alarm
+#define ALARM_CLEARED_COLOR 0x00A000FF // Green, the marker of a cleared alarm
+#define MAX_ALARMS 64 // The largest number of alarm rules
+#define ALARM_BLOCK 256 // The number of samples of a channel evaluated against its alarm rules at once
+#define ALARM_LOG_SIZE 1024 // The number of entries of the alarm event log (a power of two)
+#define HISTORY_SIZE (1 << 20) // The default number of samples retained per trace panel for scrollback (a power of two)
+#define PAN_STEPS 10 // The number of steps per panel width when panning with the arrow keys or the mouse wheel
+#define ENVELOPE_COLOR 0xFFB0B0FF // Light red, the span between the smallest and largest sample of each aggregated point
+#define PHOSPHOR_MAX 0xF000 // The largest hit count of a pixel of the persistence display
+#define PHOSPHOR_FULL 1024 // The hit count drawn with the last palette color
+#define PHOSPHOR_DECAY_MS 16 // The time in milliseconds between two decay steps of the persistence display
+#define PHOSPHOR_CLEAR_STEPS 256 // The number of decay steps after which every hit count has faded out
+
+// An enumeration of the kinds of panels
+enum { PANEL_TRACE, PANEL_SPECTRUM };
+
+// An enumeration of the latency tracing stages: from the first read of the bytes (in the helper, if it stamped them)
+// to the parse in the grapher, from the parse to the store into the points array, from the store to the present, and in total
+enum { STAGE_TRANSPORT, STAGE_STORE, STAGE_PRESENT, STAGE_TOTAL, NUM_STAGES };
+
+// An enumeration of the kinds of inputs of trace panels
+enum { INPUT_FILE, INPUT_SERIAL, INPUT_UNIX_STREAM, INPUT_UNIX_DGRAM, INPUT_UDP };
+
+// A structure to store one entry of the monotonic queues used for the windowed minimum and maximum
+typedef struct {
+    float value; // The sample value
+    long seq; // The sequence number of the sample
+} WedgeEntry;
+
+// A structure to store the statistics of the samples in a panel's window, updated in O(1) per added and evicted sample
+typedef struct {
+    long seq; // The sequence number of the next sample
+    int count; // The number of non-NAN samples in the window
+    double shift; // The value subtracted from the samples before summing them, to avoid cancellation in the variance
+    double sum; // The sum of the shifted samples
+    double sum_sq; // The sum of the squared shifted samples
+    int until_recompute; // The number of samples left before the sums are recomputed from scratch to bound rounding drift
+
+    WedgeEntry *min_queue; // The monotonic queue of increasing values whose front is the window minimum
+    WedgeEntry *max_queue; // The monotonic queue of decreasing values whose front is the window maximum
+    int min_head, min_len; // The front position and length of the minimum queue (a ring of the window size)
+    int max_head, max_len; // The front position and length of the maximum queue (a ring of the window size)
+
+    uint32_t *buckets; // The quantile histogram: the number of samples in the window per bucket
+    uint32_t *groups; // The number of samples in the window per group of QUANTILE_GROUP buckets
+} WindowStats;
+
+// A structure to store the timestamps of a batch of samples that arrived together, for latency tracing
+typedef struct {
+    long long read_ns; // The time the bytes were read from the source (stamped by the helper, or by the grapher's own read)
+    long long parse_ns; // The time the grapher started parsing them
+    long long store_ns; // The time the last sample of the batch was stored in the points array
+    int samples; // The number of samples in the batch
+} TraceBatch;
+
+// A structure to store a latency histogram with power-of-two buckets
+typedef struct {
+    unsigned long counts[TRACE_BUCKETS]; // The number of samples per bucket; bucket b holds latencies below 2^b microseconds
+    unsigned long total; // The number of samples
+    double sum_ns; // The sum of the latencies, for the mean
+    long long max_ns; // The largest latency
+} LatencyHistogram;
+
+// A structure to store the state of a live spectrum: the sample queue fed by the ingest path, the FFT worker thread
+// and the double buffer through which the worker publishes spectra to the render loop
+typedef struct {
+    int size; // The number of samples per FFT (a power of two)
+    int hop; // The number of new samples between two FFTs
+
+    float *ring; // The single-producer single-consumer queue of samples from the ingest path to the worker
+    unsigned long ring_mask; // The queue size minus one (the queue size is a power of two)
+    _Atomic unsigned long head; // The number of samples ever written to the queue (written by the ingest path)
+    _Atomic unsigned long tail; // The number of samples ever taken from the queue (written by the worker)
+    int pending; // The number of samples queued since the worker was last woken up
+    long dropped; // The number of samples dropped because the worker fell behind
+    sem_t ready; // Posted once per hop of queued samples
+
+    float *samples; // The most recent size samples, oldest first (worker only)
+    float *window; // The Hann window (worker only)
+    float *work; // The interleaved complex FFT buffer of size / 2 points (worker only)
+    float *twiddles; // The interleaved complex twiddle factors of the size / 2 point FFT
+    float *split_twiddles; // The interleaved complex twiddle factors that split it into the real size point FFT
+    int *bit_reverse; // The bit reversal permutation of the size / 2 point FFT
+
+    float *bins[2]; // The double buffer of published spectra, size / 2 + 1 magnitudes in dB each
+    _Atomic unsigned long published; // The number of spectra published; bins[published & 1] holds the newest
+    float *display; // The render loop's copy of the newest spectrum
+    float *fetched; // The render loop's scratch copy of a spectrum, swapped with display once it is known to be whole
+    unsigned long displayed; // The value of published when display was copied
+
+    _Atomic int quit; // Set to 1 to stop the worker
+    pthread_t thread; // The worker thread
+} Spectrum;
+
+// A structure to store the target of the drawing functions: the renderer, or the pixels of the locked framebuffer texture
+typedef struct {
+    SDL_Renderer *renderer; // The renderer to draw with when pixels is NULL
+    Uint32 *pixels; // The ARGB8888 pixels of the locked framebuffer texture, or NULL to draw with the renderer
+    int pitch; // The number of pixels per row of the framebuffer
+    SDL_Rect bounds; // The area of the window the canvas may draw to
+    SDL_Rect viewport; // The area of the window that drawing coordinates are relative to
+    SDL_Rect clip; // The part of the viewport inside the bounds, in window coordinates
+    Uint32 color; // The current draw color (0xRRGGBBAA)
+    SDL_Point *vertices; // A scratch array of line vertices, large enough for the widest panel
+    int capacity; // The capacity of the vertex array
+} Canvas;
+
+// A structure to store the y axis ticks of a trace panel and the mapping they were laid out for
+typedef struct {
+    float min_y; // The minimum y value of the panel when the ticks were laid out
+    float max_y; // The maximum y value of the panel when the ticks were laid out
+    float scale; // The scale factor of the panel when the ticks were laid out
+    float offset; // The offset of the panel when the ticks were laid out
+    int height; // The height of the panel when the ticks were laid out
+    int count; // The number of ticks
+    int rows[MAX_TICKS]; // The row of every tick inside the panel
+    char labels[MAX_TICKS][TICK_LABEL]; // The label of every tick
+} TickLayout;
+
+// An enumeration of the conditions an alarm rule watches
+enum { ALARM_HIGH, ALARM_LOW, ALARM_RATE, NUM_CONDITIONS };
+
+// A structure to store an alarm rule of an input channel and the state of its conditions
+typedef struct {
+    int channel; // The input channel (0 for the first input) the rule watches
+    float high; // The high limit (INFINITY if none)
+    float low; // The low limit (-INFINITY if none)
+    float rate; // The largest change between two consecutive samples (INFINITY if none)
+    float hysteresis; // How far back inside a limit a value must come for the alarm to clear
+    int duration; // The number of consecutive samples a condition must hold before its alarm is raised
+    int active[NUM_CONDITIONS]; // 1 while the alarm of a condition is raised
+    int count[NUM_CONDITIONS]; // The number of consecutive samples a condition has held while its alarm is not raised
+} AlarmRule;
+
+// A structure to store an entry of the alarm event log
+typedef struct {
+    struct timespec time; // The wall clock time the event was detected
+    long seq; // The sequence number of the sample of the channel that raised or cleared the alarm
+    int rule; // The index of the alarm rule
+    int condition; // The condition of the rule (ALARM_HIGH, ALARM_LOW or ALARM_RATE)
+    int raised; // 1 if the alarm was raised, 0 if it cleared
+    float value; // The value that raised or cleared the alarm (the change between two samples for ALARM_RATE)
+} AlarmEvent;
+
+// A structure to store one panel of the dashboard: its input source, its samples and its autoscale state
+typedef struct {
+    int kind; // The kind of panel (PANEL_TRACE or PANEL_SPECTRUM)
+    int input; // The kind of input (INPUT_FILE, INPUT_SERIAL or one of the socket inputs)
+    const char *path; // The input path ("-" for stdin), or the socket path or UDP port
+    speed_t baud; // The baud rate constant of a serial input
+    int fd; // The input file descriptor (-1 once the input is closed)
+    int listen_fd; // The listening socket of a Unix stream input, whose newest connection is fd (-1 for other inputs)
+    unsigned long datagrams; // The number of datagrams received by a datagram socket input
+    unsigned long truncated; // The number of datagrams longer than DGRAM_SIZE, which were cut short
+    unsigned long dropped; // The number of datagrams the kernel dropped because the socket's receive buffer was full
+    TraceBatch trace[TRACE_PENDING]; // The batches of samples stored since the last present, when tracing
+    int trace_len; // The number of batches in trace
+    int pollable; // 1 if the input is registered with epoll, 0 if it is a regular file read on every loop
+    char buffer[INPUT_BUFFER]; // The bytes read from the input that do not form a complete line yet
+    int buffer_len; // The number of bytes in the buffer
+
+    float *points; // The ring buffer of samples, one per pixel column
+    float *lows; // The ring buffer of the smallest sample aggregated into each point (the point itself for a raw sample)
+    float *highs; // The ring buffer of the largest sample aggregated into each point (the point itself for a raw sample)
+    int aggregated; // 1 once the input sent a "#b min,max,mean,count" line, so that the envelope of the points is drawn
+    int index; // The position of the oldest sample (and of the next write) in the ring buffer
+    int num_points; // The number of samples in the ring buffer
+
+    float min_y; // The minimum y value in the points array
+    float max_y; // The maximum y value in the points array
+    float scale; // The scale factor for mapping y values to panel height
+    float zoom; // The zoom factor applied on top of the autoscale by the zoom slider
+    float offset; // The offset for adjusting vertical position of graph
+    int active_slider; // Which slider is active (0 for none, 1 for offset, 2 for zoom)
+    int dirty; // 1 if the panel changed since it was last drawn
+    WindowStats stats; // The statistics of the samples in the points array
+    Spectrum *spectrum; // The spectrum fed by the samples of a trace panel or drawn by a spectrum panel (NULL if none)
+    uint16_t *hits; // The decaying hit counts of the persistence display, one row per pixel and one column per ring buffer slot (NULL if off)
+    int hits_pending; // The number of samples stored since they were last added to the hit counts
+    TickLayout ticks; // The cached y axis ticks of a trace panel
+    char readout[3 * TICK_LABEL]; // The text of the newest value readout
+    char hover_readout[3 * TICK_LABEL]; // The text of the readout under the mouse cursor
+    long sample_seq; // The number of samples stored in the panel since it was opened
+    int has_alarms; // 1 if any alarm rule watches the panel
+    float alarm_values[ALARM_BLOCK + 1]; // The last sample of the previous block followed by the new samples, for the alarm rules
+    float alarm_lows[ALARM_BLOCK]; // The lows of the new samples
+    float alarm_highs[ALARM_BLOCK]; // The highs of the new samples
+    int alarm_len; // The number of new samples waiting for the alarm rules
+    float *history; // The retained samples, a ring buffer of history_size slots indexed by sample sequence number
+    float *history_lows; // The lows of the retained samples
+    float *history_highs; // The highs of the retained samples
+    long view_end; // The sequence number one past the newest sample shown while paused
+    int view_stale; // 1 if the paused view moved since its statistics were last rebuilt
+    WindowStats view_stats; // The statistics of the samples shown while paused
+
+    SDL_Rect rect; // The area of the window covered by the panel
+} Panel;
+
+// A global array to store the panels of the dashboard
+Panel panels[MAX_PANELS];
+
+// A global variable to store the number of panels
+int num_panels = 0;
+
+// A global variable to store the epoll instance used to multiplex the inputs
+int epoll_fd = -1;
+
+// A global array to store the canvases the panels are drawn on: one vertical strip of the window each, rasterized by its own thread
+// The renderer path draws everything through the first one
+Canvas strips[MAX_STRIPS];
+
+// A global variable to store the number of strips in use
+int num_strips = 1;
+
+// A global array to store the worker threads rasterizing the strips after the first one, which the main thread rasterizes itself
+pthread_t strip_threads[MAX_STRIPS];
+
+// Global barriers to start the strip workers on a frame and to wait for all strips to finish before the present
+pthread_barrier_t frame_start;
+pthread_barrier_t frame_done;
+
+// A global variable to tell the strip workers to exit when they pass the start barrier
+int strips_quit = 0;
+
+// A global pointer to store the streaming texture the software rasterizer draws into (NULL when drawing with the renderer)
+SDL_Texture *framebuffer = NULL;
+
+// A global variable to store whether the panels are rasterized in software into the framebuffer texture
+int software_raster = 0;
+
+// A global string to store the characters of the embedded bitmap font, in atlas order
+const char font_chars[] = " +-.0123456789:=aefinsxy";
+
+// A global array to store the embedded 5x7 bitmap font: seven rows per character, the five high bits of the low byte of each row from left to right
+const Uint8 font_rows[][7] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // '+'
+    {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // '-'
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // '.'
+    {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // '0'
+    {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // '1'
+    {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // '2'
+    {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // '3'
+    {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // '4'
+    {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // '5'
+    {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // '6'
+    {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // '7'
+    {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // '8'
+    {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // '9'
+    {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // ':'
+    {0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // '='
+    {0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F}, // 'a'
+    {0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E}, // 'e'
+    {0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08}, // 'f'
+    {0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E}, // 'i'
+    {0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11}, // 'n'
+    {0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E}, // 's'
+    {0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11}, // 'x'
+    {0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E}, // 'y'
+};
+
+// A global array to store the glyph atlas of the font: one row of FONT_WIDTH x FONT_HEIGHT cells, 1 where a glyph pixel is set
+Uint8 font_atlas_pixels[FONT_HEIGHT][FONT_GLYPHS * FONT_WIDTH];
+
+// A global array to store the atlas cell of every ASCII character (characters missing from the font use the space)
+Uint8 font_glyph[128];
+
+// A global pointer to store the glyph atlas as a texture, for drawing text with the renderer (NULL with the software rasterizer)
+SDL_Texture *font_atlas = NULL;
+
+// Global variables to store the trace panel under the mouse and the column of the panel the mouse is on (NULL and -1 if none)
+Panel *hover_panel = NULL;
+int hover_x = -1;
+
+// A global array to store the buffers that recvmmsg receives datagrams into, shared by all datagram inputs
+// Each one has room after the datagram for the newline that ends its last line and for the terminator parse_values writes
+char dgram_buffers[DGRAM_BATCH][DGRAM_SIZE + 2];
+
+// A global pointer to store the Chrome trace file the latency of every batch of samples is written to (NULL if not tracing)
+FILE *trace_file = NULL;
+
+// A global array to store the latency histograms of the tracing stages
+LatencyHistogram trace_histograms[NUM_STAGES];
+
+// A global variable to store the time tracing started, which is the origin of the trace file's timestamps
+long long trace_start_ns = 0;
+
+// A global variable to store whether the statistics overlay is drawn (toggled with the S key)
+int show_stats = 1;
+
+// A global variable to store whether the trace panels keep a persistence display
+int persistence = 0;
+
+// A global variable to store whether the persistence display is drawn in place of the trace (toggled with the P key)
+int show_persistence = 1;
+
+// A global array to store the colors of the persistence display, from no hits to PHOSPHOR_FULL hits
+Uint32 phosphor_palette[256];
+
+// A global array to store the palette entry of every hit count
+Uint8 phosphor_levels[PHOSPHOR_MAX + 1];
+
+// A global variable to store the number of decay steps applied to the persistence display in the current frame
+int phosphor_steps = 0;
+
+// A global variable to store the time up to which the persistence display has been decayed
+Uint32 phosphor_decayed = 0;
+
+// A global variable to store the number of samples retained per trace panel (a power of two)
+int history_size = HISTORY_SIZE;
+
+// A global variable to store whether the trace panels show a frozen view of their history instead of the newest samples
+int paused = 0;
+
+// A global array to store the alarm rules
+AlarmRule alarm_rules[MAX_ALARMS];
+
+// A global variable to store the number of alarm rules
+int num_alarms = 0;
+
+// A global array to store the alarm event log: a single-producer ring written by the ingest path, drained by the log writer thread
+// and read by the renderer, which only runs while the ingest path does not
+AlarmEvent alarm_log[ALARM_LOG_SIZE];
+
+// Global counters to store the number of events ever posted to and written from the alarm event log
+atomic_ulong alarm_head;
+atomic_ulong alarm_tail;
+
+// A global variable to store the number of events dropped because the log writer fell a whole log behind
+unsigned long alarm_dropped = 0;
+
+// Global variables to store the file the alarm events are written to and the thread writing them, woken by the semaphore
+FILE *alarm_file = NULL;
+pthread_t alarm_thread;
+sem_t alarm_ready;
+atomic_int alarm_quit;
+
+// A function to set the draw color of the renderer from a 0xRRGGBBAA constant
+void set_color(SDL_Renderer *renderer, Uint32 color) {
+    SDL_SetRenderDrawColor(renderer, (color >> 24) & 0xFF, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+}
+
+// A function to convert a 0xRRGGBBAA constant to an opaque ARGB8888 pixel
+Uint32 to_pixel(Uint32 color) {
+    return 0xFF000000u | (color >> 8);
+}
+
+// A function to blend a 0xRRGGBBAA color over an ARGB8888 pixel
+Uint32 blend_pixel(Uint32 pixel, Uint32 color) {
+    Uint32 alpha = color & 0xFF;
+    Uint32 rb = ((((color >> 8) & 0xFF00FF) * alpha + (pixel & 0xFF00FF) * (255 - alpha)) >> 8) & 0xFF00FF;
+    Uint32 g = ((((color >> 16) & 0xFF) * alpha + ((pixel >> 8) & 0xFF) * (255 - alpha)) >> 8) & 0xFF;
+    return 0xFF000000u | rb | (g << 8);
+}
+
+// A function to set the area of the window that the drawing coordinates of a canvas are relative to, and clip to it
+void canvas_set_viewport(Canvas *canvas, const SDL_Rect *viewport) {
+    canvas->viewport = *viewport;
+    int x0 = viewport->x > canvas->bounds.x ? viewport->x : canvas->bounds.x;
+    int y0 = viewport->y > canvas->bounds.y ? viewport->y : canvas->bounds.y;
+    int x1 = viewport->x + viewport->w < canvas->bounds.x + canvas->bounds.w ? viewport->x + viewport->w : canvas->bounds.x + canvas->bounds.w;
+    int y1 = viewport->y + viewport->h < canvas->bounds.y + canvas->bounds.h ? viewport->y + viewport->h : canvas->bounds.y + canvas->bounds.h;
+    canvas->clip = (SDL_Rect){x0, y0, x1 > x0 ? x1 - x0 : 0, y1 > y0 ? y1 - y0 : 0};
+    if (canvas->pixels == NULL) SDL_RenderSetViewport(canvas->renderer, viewport);
+}
+
+// A function to set the draw color of a canvas from a 0xRRGGBBAA constant
+void canvas_set_color(Canvas *canvas, Uint32 color) {
+    canvas->color = color;
+    if (canvas->pixels == NULL) set_color(canvas->renderer, color);
+}
+
+// A function to fill a rectangle of a canvas with its draw color, blending it if it is translucent
+void canvas_fill_rect(Canvas *canvas, int x, int y, int w, int h) {
+    // Draw with the renderer
+    if (canvas->pixels == NULL) {
+        SDL_Rect rect = {x, y, w, h};
+        if ((canvas->color & 0xFF) != 0xFF) SDL_SetRenderDrawBlendMode(canvas->renderer, SDL_BLENDMODE_BLEND);
+        SDL_RenderFillRect(canvas->renderer, &rect);
+        if ((canvas->color & 0xFF) != 0xFF) SDL_SetRenderDrawBlendMode(canvas->renderer, SDL_BLENDMODE_NONE);
+        return;
+    }
+
+    // Clip the rectangle in window coordinates
+    x += canvas->viewport.x;
+    y += canvas->viewport.y;
+    int x0 = x > canvas->clip.x ? x : canvas->clip.x;
+    int y0 = y > canvas->clip.y ? y : canvas->clip.y;
+    int x1 = x + w < canvas->clip.x + canvas->clip.w ? x + w : canvas->clip.x + canvas->clip.w;
+    int y1 = y + h < canvas->clip.y + canvas->clip.h ? y + h : canvas->clip.y + canvas->clip.h;
+
+    // Write or blend the pixels row by row
+    Uint32 pixel = to_pixel(canvas->color);
+    int opaque = (canvas->color & 0xFF) == 0xFF;
+    for (int row = y0; row < y1; row++) {
+        Uint32 *p = canvas->pixels + (size_t)row * canvas->pitch;
+        if (opaque) {
+            for (int col = x0; col < x1; col++) p[col] = pixel;
+        }
+        else {
+            for (int col = x0; col < x1; col++) p[col] = blend_pixel(p[col], canvas->color);
+        }
+    }
+}
+
+// A function to fill the whole area of a canvas with a color
+void canvas_clear(Canvas *canvas, Uint32 color) {
+    canvas_set_viewport(canvas, &canvas->bounds);
+    canvas_set_color(canvas, color);
+    if (canvas->pixels == NULL) {
+        SDL_RenderClear(canvas->renderer);
+        return;
+    }
+    canvas_fill_rect(canvas, 0, 0, canvas->bounds.w, canvas->bounds.h);
+}
+
+// A function to draw a vertical span of pixels in one column of the framebuffer, in window coordinates, both ends included
+// This is the kernel for the trace: a segment between neighbouring columns is drawn as two half spans
+void raster_span(Canvas *canvas, int x, int y0, int y1) {
+    if (x < canvas->clip.x || x >= canvas->clip.x + canvas->clip.w) return;
+    if (y0 > y1) {
+        int t = y0;
+        y0 = y1;
+        y1 = t;
+    }
+    if (y0 < canvas->clip.y) y0 = canvas->clip.y;
+    if (y1 >= canvas->clip.y + canvas->clip.h) y1 = canvas->clip.y + canvas->clip.h - 1;
+    if (y0 > y1) return;
+    Uint32 pixel = to_pixel(canvas->color);
+    Uint32 *p = canvas->pixels + (size_t)y0 * canvas->pitch + x;
+    for (int y = y0; y <= y1; y++, p += canvas->pitch) *p = pixel;
+}
+
+// A function to draw a line of any slope into the framebuffer with Bresenham's algorithm, in window coordinates
+void raster_line(Canvas *canvas, int x0, int y0, int x1, int y1) {
+    Uint32 pixel = to_pixel(canvas->color);
+    int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    while (1) {
+        if (x0 >= canvas->clip.x && x0 < canvas->clip.x + canvas->clip.w && y0 >= canvas->clip.y && y0 < canvas->clip.y + canvas->clip.h) {
+            canvas->pixels[(size_t)y0 * canvas->pitch + x0] = pixel;
+        }
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+// A function to draw connected lines through an array of vertices on a canvas with its draw color
+void canvas_draw_lines(Canvas *canvas, const SDL_Point *vertices, int count) {
+    // Draw with the renderer
+    if (canvas->pixels == NULL) {
+        SDL_RenderDrawLines(canvas->renderer, vertices, count);
+        return;
+    }
+
+    // Rasterize segments between neighbouring columns as column spans meeting half way, and other segments as lines
+    int ox = canvas->viewport.x;
+    int oy = canvas->viewport.y;
+    for (int i = 0; i + 1 < count; i++) {
+        int x0 = vertices[i].x + ox, y0 = vertices[i].y + oy;
+        int x1 = vertices[i + 1].x + ox, y1 = vertices[i + 1].y + oy;
+        if (x1 == x0 + 1) {
+            int middle = (y0 + y1) / 2;
+            raster_span(canvas, x0, y0, middle);
+            raster_span(canvas, x1, middle, y1);
+        }
+        else {
+            raster_line(canvas, x0, y0, x1, y1);
+        }
+    }
+}
+
+// A function to draw a line of text from the glyph atlas on a canvas with its draw color, with its top left corner at x, y
+void canvas_draw_text(Canvas *canvas, int x, int y, const char *text) {
+    // Draw with the renderer, tinting the white atlas texture
+    if (canvas->pixels == NULL) {
+        SDL_SetTextureColorMod(font_atlas, (canvas->color >> 24) & 0xFF, (canvas->color >> 16) & 0xFF, (canvas->color >> 8) & 0xFF);
+        for (int i = 0; text[i] != '\0'; i++) {
+            SDL_Rect src = {font_glyph[text[i] & 0x7F] * FONT_WIDTH, 0, FONT_WIDTH, FONT_HEIGHT};
+            SDL_Rect dst = {x + i * FONT_WIDTH, y, FONT_WIDTH, FONT_HEIGHT};
+            SDL_RenderCopy(canvas->renderer, font_atlas, &src, &dst);
+        }
+        return;
+    }
+
+    // Copy the set pixels of every glyph from the atlas, clipped to the canvas
+    Uint32 pixel = to_pixel(canvas->color);
+    x += canvas->viewport.x;
+    y += canvas->viewport.y;
+    for (int i = 0; text[i] != '\0'; i++, x += FONT_WIDTH) {
+        if (x >= canvas->clip.x + canvas->clip.w || x + FONT_WIDTH <= canvas->clip.x) continue;
+        int cell = font_glyph[text[i] & 0x7F] * FONT_WIDTH;
+        for (int row = 0; row < FONT_HEIGHT; row++) {
+            if (y + row < canvas->clip.y || y + row >= canvas->clip.y + canvas->clip.h) continue;
+            Uint32 *p = canvas->pixels + (size_t)(y + row) * canvas->pitch;
+            for (int col = 0; col < FONT_WIDTH; col++) {
+                if (font_atlas_pixels[row][cell + col] && x + col >= canvas->clip.x && x + col < canvas->clip.x + canvas->clip.w) p[x + col] = pixel;
+            }
+        }
+    }
+}
+
+// A function to initialize the SDL library and create a window and a renderer
+int init(SDL_Window **window, SDL_Renderer **renderer) {
+    // Initialize SDL
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        fprintf(stderr, "SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    // Create a window
+    *window = SDL_CreateWindow("Rolling Graph", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+    if (*window == NULL) {
+        fprintf(stderr, "Window could not be created! SDL_Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    // Create a renderer, falling back to any renderer (usually SDL's software one) on hosts without an accelerated one
+    *renderer = SDL_CreateRenderer(*window, -1, SDL_RENDERER_ACCELERATED);
+    if (*renderer == NULL) {
+        *renderer = SDL_CreateRenderer(*window, -1, 0);
+    }
+    if (*renderer == NULL) {
+        fprintf(stderr, "Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    // Return success
+    return 1;
+}
+
+// A function to pack the embedded font into the glyph atlas, and upload it as a texture when drawing with the renderer
+int font_init(SDL_Renderer *renderer, int software) {
+    // Lay the glyphs out side by side, leaving the last column and row of every cell empty as spacing
+    for (int g = 0; g < FONT_GLYPHS; g++) {
+        for (int row = 0; row < 7; row++) {
+            for (int col = 0; col < 5; col++) {
+                font_atlas_pixels[row][g * FONT_WIDTH + col] = (font_rows[g][row] >> (4 - col)) & 1;
+            }
+        }
+    }
+
+    // Map every ASCII character to its cell
+    memset(font_glyph, 0, sizeof(font_glyph));
+    for (int g = 0; g < FONT_GLYPHS; g++) font_glyph[(int)font_chars[g]] = g;
+    if (software) return 1;
+
+    // Upload the atlas as white pixels whose alpha is the glyph coverage, so that text is tinted with the color modulation
+    static Uint32 pixels[FONT_HEIGHT][FONT_GLYPHS * FONT_WIDTH];
+    for (int row = 0; row < FONT_HEIGHT; row++) {
+        for (int col = 0; col < FONT_GLYPHS * FONT_WIDTH; col++) {
+            pixels[row][col] = font_atlas_pixels[row][col] ? 0xFFFFFFFFu : 0x00FFFFFFu;
+        }
+    }
+    font_atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, FONT_GLYPHS * FONT_WIDTH, FONT_HEIGHT);
+    if (font_atlas == NULL) {
+        fprintf(stderr, "Glyph atlas could not be created! SDL_Error: %s\n", SDL_GetError());
+        return 0;
+    }
+    SDL_UpdateTexture(font_atlas, NULL, pixels, sizeof(pixels[0]));
+    SDL_SetTextureBlendMode(font_atlas, SDL_BLENDMODE_BLEND);
+    return 1;
+}
+
+// A function to close the SDL library, destroy the window and the renderer and release the panels
+void close_sdl(SDL_Window *window, SDL_Renderer *renderer) {
+    // Destroy the window and the renderer
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+
+    // Close the inputs and free the points arrays
+    for (int i = 0; i < num_panels; i++) {
+        if (panels[i].fd > STDIN_FILENO) close(panels[i].fd);
+        if (panels[i].listen_fd != -1) close(panels[i].listen_fd);
+        if (panels[i].input == INPUT_UNIX_STREAM || panels[i].input == INPUT_UNIX_DGRAM) unlink(panels[i].path);
+        free(panels[i].points);
+        free(panels[i].lows);
+        free(panels[i].highs);
+        free(panels[i].stats.min_queue);
+        free(panels[i].stats.max_queue);
+        free(panels[i].stats.buckets);
+        free(panels[i].stats.groups);
+        free(panels[i].hits);
+        free(panels[i].history);
+        free(panels[i].history_lows);
+        free(panels[i].history_highs);
+        free(panels[i].view_stats.min_queue);
+        free(panels[i].view_stats.max_queue);
+        free(panels[i].view_stats.buckets);
+        free(panels[i].view_stats.groups);
+    }
+    for (int i = 0; i < num_strips; i++) free(strips[i].vertices);
+    if (framebuffer != NULL) SDL_DestroyTexture(framebuffer);
+    if (font_atlas != NULL) SDL_DestroyTexture(font_atlas);
+    if (epoll_fd != -1) close(epoll_fd);
+
+    // Quit SDL
+    SDL_Quit();
+}
+
+// A function to create a socket input bound to a Unix-domain path or to a UDP port on loopback
+// Stream sockets listen for producers; datagram sockets get a large receive buffer and report kernel drops
+int init_socket(Panel *panel) {
+    // Check that a UDP port is a whole number from 1 to 65535
+    long port = 0;
+    if (panel->input == INPUT_UDP) {
+        char *end;
+        errno = 0;
+        port = strtol(panel->path, &end, 10);
+        if (end == panel->path || *end != '\0' || errno != 0 || port < 1 || port > 65535) {
+            fprintf(stderr, "Invalid UDP port %s!\n", panel->path);
+            return -1;
+        }
+    }
+
+    // Create the socket
+    int type = (panel->input == INPUT_UNIX_STREAM) ? SOCK_STREAM : SOCK_DGRAM;
+    int fd = socket(panel->input == INPUT_UDP ? AF_INET : AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        fprintf(stderr, "Failed to create socket for %s: %s\n", panel->path, strerror(errno));
+        return -1;
+    }
+
+    // Bind it to the port on loopback, or to the path after removing a stale socket file
+    int result;
+    if (panel->input == INPUT_UDP) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        result = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    }
+    else {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, panel->path, sizeof(addr.sun_path) - 1);
+        unlink(panel->path);
+        result = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    }
+    if (result != 0 || (type == SOCK_STREAM && listen(fd, 1) != 0)) {
+        fprintf(stderr, "Failed to bind socket to %s: %s\n", panel->path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    // Enlarge the receive buffer and ask for the kernel's drop counter with each datagram
+    if (type == SOCK_DGRAM) {
+        int size = SOCKET_RCVBUF;
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on));
+    }
+
+    // Return the file descriptor
+    return fd;
+}
+
+// A function to register a file descriptor of a panel with epoll, tagging it with the panel index and whether it is a listening socket
+int watch_fd(Panel *panel, int fd, int listener) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = (uint64_t)(panel - panels) << 1 | listener;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+// A function to open the input of a panel and register it with epoll
+int open_input(Panel *panel) {
+    // Listen on a Unix stream socket; the connections are accepted and read as they come
+    if (panel->input == INPUT_UNIX_STREAM) {
+        panel->listen_fd = init_socket(panel);
+        if (panel->listen_fd == -1 || watch_fd(panel, panel->listen_fd, 1) != 0) return 0;
+        panel->pollable = 1;
+        return 1;
+    }
+
+    // Open the input without blocking, so that a FIFO without a writer does not stall the other panels
+    // Serial ports are configured and read directly, without a helper process and pipe in between
+    if (panel->input == INPUT_UDP || panel->input == INPUT_UNIX_DGRAM) {
+        panel->fd = init_socket(panel);
+        if (panel->fd == -1) return 0;
+    }
+    else if (panel->input == INPUT_SERIAL) {
+        panel->fd = init_serial(panel->path, panel->baud);
+        if (panel->fd == -1) return 0;
+    }
+    else if (strcmp(panel->path, "-") == 0) {
+        panel->fd = STDIN_FILENO;
+        fcntl(panel->fd, F_SETFL, fcntl(panel->fd, F_GETFL) | O_NONBLOCK);
+    }
+    else {
+        panel->fd = open(panel->path, O_RDONLY | O_NONBLOCK);
+    }
+    if (panel->fd == -1) {
+        fprintf(stderr, "Failed to open %s: %s\n", panel->path, strerror(errno));
+        return 0;
+    }
+
+    // Register the input with epoll; regular files cannot be polled and are read on every loop instead
+    if (watch_fd(panel, panel->fd, 0) == 0) {
+        panel->pollable = 1;
+    }
+    else if (errno == EPERM) {
+        panel->pollable = 0;
+    }
+    else {
+        fprintf(stderr, "Failed to watch %s: %s\n", panel->path, strerror(errno));
+        return 0;
+    }
+
+    // Return success
+    return 1;
+}
+
+// A function to close the input of a panel, reopening it if it is a FIFO so that the next writer is picked up
+void close_input(Panel *panel) {
+    // Check whether the input is a FIFO before closing it
+    struct stat st;
+    int reopen = panel->input == INPUT_FILE && panel->fd != STDIN_FILENO && fstat(panel->fd, &st) == 0 && S_ISFIFO(st.st_mode);
+    if (panel->input == INPUT_SERIAL) fprintf(stderr, "Serial port %s closed\n", panel->path);
+
+    // Unregister and close the input; a Unix stream input keeps listening for the next connection
+    if (panel->pollable) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, panel->fd, NULL);
+    if (panel->fd != STDIN_FILENO) close(panel->fd);
+    panel->fd = -1;
+    panel->buffer_len = 0;
+
+    // Wait for the next writer of a FIFO
+    if (reopen && !open_input(panel)) {
+        panel->fd = -1;
+    }
+}
+
+// A function to map a sample to its quantile histogram bucket, using the leading bits of its float representation
+// flipped so that the unsigned order of the keys is the order of the values (under 1% relative bucket width)
+int quantile_bucket(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t key = (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    return key >> (32 - QUANTILE_BUCKET_BITS);
+}
+
+// A function to get the value in the middle of a quantile histogram bucket
+float quantile_bucket_value(int bucket) {
+    uint32_t key = ((uint32_t)bucket << (32 - QUANTILE_BUCKET_BITS)) | (1u << (31 - QUANTILE_BUCKET_BITS));
+    uint32_t bits = (key & 0x80000000u) ? key & 0x7FFFFFFFu : ~key;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// A function to add a sample to the windowed statistics, in O(1) (amortized for the minimum and maximum)
+// The sums and quantiles use the value; the minimum and maximum use the low and high of its aggregated block
+// Non-finite samples ("inf" or overflows like "1e39") are skipped like NAN, so they cannot poison the sums
+void stats_add(WindowStats *stats, int window, float value, float low, float high) {
+    long seq = stats->seq++;
+    if (!isfinite(value)) return;
+    if (!isfinite(low)) low = value;
+    if (!isfinite(high)) high = value;
+
+    // Update the shifted sums
+    double d = value - stats->shift;
+    stats->count++;
+    stats->sum += d;
+    stats->sum_sq += d * d;
+
+    // Drop the queued values that can no longer be the minimum or maximum, then queue the new value
+    while (stats->min_len > 0 && stats->min_queue[(stats->min_head + stats->min_len - 1) % window].value >= low) stats->min_len--;
+    stats->min_queue[(stats->min_head + stats->min_len++) % window] = (WedgeEntry){low, seq};
+    while (stats->max_len > 0 && stats->max_queue[(stats->max_head + stats->max_len - 1) % window].value <= high) stats->max_len--;
+    stats->max_queue[(stats->max_head + stats->max_len++) % window] = (WedgeEntry){high, seq};
+
+    // Count the sample in its quantile bucket
+    int bucket = quantile_bucket(value);
+    stats->buckets[bucket]++;
+    stats->groups[bucket / QUANTILE_GROUP]++;
+}
+
+// A function to remove the sample that leaves the window from the windowed statistics, in O(1)
+void stats_evict(WindowStats *stats, int window, float value, long seq) {
+    if (!isfinite(value)) return;
+
+    // Update the shifted sums
+    double d = value - stats->shift;
+    stats->count--;
+    stats->sum -= d;
+    stats->sum_sq -= d * d;
+
+    // Pop the sample from the front of the queues if it is still there
+    if (stats->min_len > 0 && stats->min_queue[stats->min_head].seq == seq) {
+        stats->min_head = (stats->min_head + 1) % window;
+        stats->min_len--;
+    }
+    if (stats->max_len > 0 && stats->max_queue[stats->max_head].seq == seq) {
+        stats->max_head = (stats->max_head + 1) % window;
+        stats->max_len--;
+    }
+
+    // Uncount the sample from its quantile bucket
+    int bucket = quantile_bucket(value);
+    stats->buckets[bucket]--;
+    stats->groups[bucket / QUANTILE_GROUP]--;
+}
+
+// A function to recompute the shifted sums of a panel from its points array, around a sample of the window
+// Called once per window length, so it costs O(1) per sample while keeping the rounding error of the sums bounded
+// The shift is taken afresh from the first finite sample, so it never carries an error over from earlier windows
+void stats_recompute(Panel *panel) {
+    WindowStats *stats = &panel->stats;
+    stats->shift = 0.0;
+    for (int i = 0; i < panel->num_points; i++) {
+        if (isfinite(panel->points[i])) {
+            stats->shift = panel->points[i];
+            break;
+        }
+    }
+    stats->sum = 0.0;
+    stats->sum_sq = 0.0;
+    for (int i = 0; i < panel->num_points; i++) {
+        if (!isfinite(panel->points[i])) continue;
+        double d = panel->points[i] - stats->shift;
+        stats->sum += d;
+        stats->sum_sq += d * d;
+    }
+    stats->until_recompute = panel->num_points;
+}
+
+// A function to empty windowed statistics and size their monotonic queues for a window
+void stats_reset(WindowStats *stats, int window) {
+    // Allocate the monotonic queues for the new window size and the histogram on first use
+    free(stats->min_queue);
+    free(stats->max_queue);
+    stats->min_queue = malloc(window * sizeof(WedgeEntry));
+    stats->max_queue = malloc(window * sizeof(WedgeEntry));
+    if (stats->buckets == NULL) stats->buckets = malloc(QUANTILE_BUCKETS * sizeof(uint32_t));
+    if (stats->groups == NULL) stats->groups = malloc(QUANTILE_BUCKETS / QUANTILE_GROUP * sizeof(uint32_t));
+
+    // Reset everything
+    memset(stats->buckets, 0, QUANTILE_BUCKETS * sizeof(uint32_t));
+    memset(stats->groups, 0, QUANTILE_BUCKETS / QUANTILE_GROUP * sizeof(uint32_t));
+    stats->seq = 0;
+    stats->count = 0;
+    stats->shift = 0.0;
+    stats->sum = 0.0;
+    stats->sum_sq = 0.0;
+    stats->min_head = stats->min_len = 0;
+    stats->max_head = stats->max_len = 0;
+}
+
+// A function to rebuild the windowed statistics of a panel from its points array, after the array was resized
+void stats_rebuild(Panel *panel) {
+    WindowStats *stats = &panel->stats;
+
+    // Reset everything and add the samples again from the oldest to the newest
+    stats_reset(stats, panel->num_points);
+    for (int k = 0; k < panel->num_points; k++) {
+        int slot = (panel->index + k) % panel->num_points;
+        stats_add(stats, panel->num_points, panel->points[slot], panel->lows[slot], panel->highs[slot]);
+    }
+    stats_recompute(panel);
+}
+
+// A function to get an approximate quantile (0 to 1) of the samples in the window from the histogram
+float stats_quantile(const WindowStats *stats, float q) {
+    // Find the group and then the bucket holding the sample of the requested rank
+    uint32_t rank = (uint32_t)(q * (stats->count - 1)) + 1;
+    int group = 0;
+    while (stats->groups[group] < rank) rank -= stats->groups[group++];
+    int bucket = group * QUANTILE_GROUP;
+    while (stats->buckets[bucket] < rank) rank -= stats->buckets[bucket++];
+    return quantile_bucket_value(bucket);
+}
+
+// A function to compute an in-place radix-2 FFT of n interleaved complex points, using the precomputed tables of a spectrum
+void fft(const Spectrum *spectrum, float *z, int n) {
+    // Reorder the points in bit reversed order
+    for (int i = 0; i < n; i++) {
+        int j = spectrum->bit_reverse[i];
+        if (j > i) {
+            float re = z[2 * i], im = z[2 * i + 1];
+            z[2 * i] = z[2 * j];
+            z[2 * i + 1] = z[2 * j + 1];
+            z[2 * j] = re;
+            z[2 * j + 1] = im;
+        }
+    }
+
+    // Combine the transforms of increasing length with butterflies, striding through the twiddle table
+    for (int len = 2; len <= n; len <<= 1) {
+        int half = len >> 1;
+        int stride = n / len;
+        for (int start = 0; start < n; start += len) {
+            for (int k = 0; k < half; k++) {
+                float wr = spectrum->twiddles[2 * k * stride], wi = spectrum->twiddles[2 * k * stride + 1];
+                float *a = &z[2 * (start + k)];
+                float *b = &z[2 * (start + k + half)];
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+// A function to compute the magnitude spectrum in dB of the samples of a spectrum into one of its bins buffers
+// The real samples are packed into a complex FFT of half the length, which is then split into the real spectrum
+void compute_spectrum(Spectrum *spectrum, float *bins) {
+    int n = spectrum->size / 2;
+    float *z = spectrum->work;
+
+    // Pack the windowed samples into complex points, even samples as real parts and odd samples as imaginary parts
+    for (int i = 0; i < spectrum->size; i++) {
+        z[i] = spectrum->samples[i] * spectrum->window[i];
+    }
+    fft(spectrum, z, n);
+
+    // Split the transform into the bins of the real spectrum, scaled so that a sine of amplitude A reads 20 log10(A)
+    float norm = 4.0f / spectrum->size;
+    for (int k = 0; k <= n; k++) {
+        float zr = z[2 * (k % n)], zi = z[2 * (k % n) + 1];
+        float cr = z[2 * ((n - k) % n)], ci = -z[2 * ((n - k) % n) + 1];
+        float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        float odr = 0.5f * (zi - ci), odi = -0.5f * (zr - cr);
+        float wr = spectrum->split_twiddles[2 * k], wi = spectrum->split_twiddles[2 * k + 1];
+        float xr = er + wr * odr - wi * odi;
+        float xi = ei + wr * odi + wi * odr;
+        bins[k] = 10.0f * log10f((xr * xr + xi * xi) * norm * norm + 1e-20f);
+    }
+}
+
+// A function to run the FFT worker of a spectrum: take one hop of samples at a time and publish a new spectrum for each
+void *spectrum_thread(void *arg) {
+    Spectrum *spectrum = arg;
+
+    while (1) {
+        // Wait for a hop of new samples
+        sem_wait(&spectrum->ready);
+        if (atomic_load(&spectrum->quit)) break;
+
+        // Slide the samples by one hop and append the new samples from the queue
+        unsigned long tail = atomic_load_explicit(&spectrum->tail, memory_order_relaxed);
+        unsigned long head = atomic_load_explicit(&spectrum->head, memory_order_acquire);
+        int count = head - tail < (unsigned long)spectrum->hop ? (int)(head - tail) : spectrum->hop;
+        memmove(spectrum->samples, spectrum->samples + count, (spectrum->size - count) * sizeof(float));
+        for (int i = 0; i < count; i++) {
+            spectrum->samples[spectrum->size - count + i] = spectrum->ring[(tail + i) & spectrum->ring_mask];
+        }
+        atomic_store_explicit(&spectrum->tail, tail + count, memory_order_release);
+
+        // Compute the spectrum into the buffer that is not being shown and publish it
+        unsigned long published = atomic_load_explicit(&spectrum->published, memory_order_relaxed);
+        compute_spectrum(spectrum, spectrum->bins[(published + 1) & 1]);
+        atomic_store_explicit(&spectrum->published, published + 1, memory_order_release);
+    }
+
+    // Exit the thread
+    return NULL;
+}
+
+// A function to create a spectrum of the given FFT size and hop, with its tables, and start its worker thread
+Spectrum *spectrum_create(int size, int hop) {
+    Spectrum *spectrum = calloc(1, sizeof(Spectrum));
+    spectrum->size = size;
+    spectrum->hop = hop;
+    int n = size / 2;
+
+    // Allocate the sample queue and the worker's buffers
+    unsigned long ring_size = 1;
+    while (ring_size < (unsigned long)hop * FFT_RING_HOPS) ring_size <<= 1;
+    spectrum->ring = malloc(ring_size * sizeof(float));
+    spectrum->ring_mask = ring_size - 1;
+    spectrum->samples = calloc(size, sizeof(float));
+    spectrum->window = malloc(size * sizeof(float));
+    spectrum->work = malloc(size * sizeof(float));
+    spectrum->twiddles = malloc(n * sizeof(float));
+    spectrum->split_twiddles = malloc((n + 1) * 2 * sizeof(float));
+    spectrum->bit_reverse = malloc(n * sizeof(int));
+    for (int i = 0; i < 2; i++) {
+        spectrum->bins[i] = calloc(n + 1, sizeof(float));
+    }
+    spectrum->display = calloc(n + 1, sizeof(float));
+    spectrum->fetched = calloc(n + 1, sizeof(float));
+
+    // Precompute the Hann window, the twiddle factors and the bit reversal permutation
+    for (int i = 0; i < size; i++) {
+        spectrum->window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / size);
+    }
+    for (int k = 0; k < n / 2; k++) {
+        spectrum->twiddles[2 * k] = cos(-2.0 * M_PI * k / n);
+        spectrum->twiddles[2 * k + 1] = sin(-2.0 * M_PI * k / n);
+    }
+    for (int k = 0; k <= n; k++) {
+        spectrum->split_twiddles[2 * k] = cos(-2.0 * M_PI * k / size);
+        spectrum->split_twiddles[2 * k + 1] = sin(-2.0 * M_PI * k / size);
+    }
+    int bits = 0;
+    while ((1 << bits) < n) bits++;
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+        }
+        spectrum->bit_reverse[i] = r;
+    }
+
+    // Start the worker
+    sem_init(&spectrum->ready, 0, 0);
+    if (pthread_create(&spectrum->thread, NULL, spectrum_thread, spectrum) != 0) {
+        fprintf(stderr, "Failed to start FFT worker!\n");
+        exit(1);
+    }
+
+    // Return the spectrum
+    return spectrum;
+}
+
+// A function to stop the worker of a spectrum and free it
+void spectrum_destroy(Spectrum *spectrum) {
+    // Stop and join the worker
+    atomic_store(&spectrum->quit, 1);
+    sem_post(&spectrum->ready);
+    pthread_join(spectrum->thread, NULL);
+    sem_destroy(&spectrum->ready);
+
+    // Free the buffers
+    free(spectrum->ring);
+    free(spectrum->samples);
+    free(spectrum->window);
+    free(spectrum->work);
+    free(spectrum->twiddles);
+    free(spectrum->split_twiddles);
+    free(spectrum->bit_reverse);
+    free(spectrum->bins[0]);
+    free(spectrum->bins[1]);
+    free(spectrum->display);
+    free(spectrum->fetched);
+    free(spectrum);
+}
+
+// A function to queue a sample for the FFT worker of a spectrum, waking it up once per hop
+void spectrum_push(Spectrum *spectrum, float value) {
+    // Drop the sample if the worker has fallen a whole queue behind
+    unsigned long head = atomic_load_explicit(&spectrum->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&spectrum->tail, memory_order_acquire) > spectrum->ring_mask) {
+        spectrum->dropped++;
+        return;
+    }
+    spectrum->ring[head & spectrum->ring_mask] = value;
+    atomic_store_explicit(&spectrum->head, head + 1, memory_order_release);
+
+    // Wake the worker up once per hop of samples
+    if (++spectrum->pending == spectrum->hop) {
+        spectrum->pending = 0;
+        sem_post(&spectrum->ready);
+    }
+}
+
+// A function to copy the newest published spectrum for drawing, without ever waiting for the worker
+// Returns 1 if a new spectrum was copied; a copy that the worker overwrote meanwhile is discarded until the next frame
+// The copy goes to a scratch buffer that only replaces the displayed spectrum once it is known to be whole
+int spectrum_fetch(Spectrum *spectrum) {
+    unsigned long published = atomic_load_explicit(&spectrum->published, memory_order_acquire);
+    if (published == spectrum->displayed) return 0;
+    memcpy(spectrum->fetched, spectrum->bins[published & 1], (spectrum->size / 2 + 1) * sizeof(float));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&spectrum->published, memory_order_relaxed) != published) return 0;
+    float *display = spectrum->display;
+    spectrum->display = spectrum->fetched;
+    spectrum->fetched = display;
+    spectrum->displayed = published;
+    return 1;
+}
+
+// A function to build the palette and the hit count levels of the persistence display
+// A single hit is already visible; the levels grow with the logarithm of the hit count up to PHOSPHOR_FULL
+void phosphor_init(void) {
+    // Ramp from the background through pale blue and blue to red and dark red
+    static const Uint32 stops[] = {0xC8D8FFFF, 0x0000FFFF, 0xFF0000FF, 0x800000FF};
+    phosphor_palette[0] = to_pixel(BACKGROUND_COLOR);
+    for (int i = 1; i < 256; i++) {
+        float t = (i - 1) / 254.0f * 3.0f;
+        int s = t < 2.0f ? (int)t : 2;
+        float f = t - s;
+        Uint32 a = stops[s], b = stops[s + 1];
+        Uint32 color = 0xFF;
+        for (int shift = 8; shift <= 24; shift += 8) {
+            float c = ((a >> shift) & 0xFF) * (1.0f - f) + ((b >> shift) & 0xFF) * f;
+            color |= (Uint32)(c + 0.5f) << shift;
+        }
+        phosphor_palette[i] = to_pixel(color);
+    }
+
+    // Map every hit count to a palette entry
+    phosphor_levels[0] = 0;
+    for (int h = 1; h <= PHOSPHOR_MAX; h++) {
+        float level = log2f(1.0f + h) / log2f(1.0f + PHOSPHOR_FULL);
+        phosphor_levels[h] = level >= 1.0f ? 255 : 1 + (int)(level * 254.0f);
+    }
+}
+
+// A function to (re)allocate the hit counts of a trace panel at its size, one column per ring buffer slot and one row per pixel
+void phosphor_resize(Panel *panel) {
+    free(panel->hits);
+    panel->hits = calloc((size_t)panel->num_points * panel->rect.h, sizeof(uint16_t));
+    panel->hits_pending = 0;
+}
+
+// A function to clear the hit counts of a trace panel, so that its persistence display starts over
+void phosphor_clear(Panel *panel) {
+    if (panel->hits == NULL) return;
+    memset(panel->hits, 0, (size_t)panel->num_points * panel->rect.h * sizeof(uint16_t));
+    panel->hits_pending = 0;
+}
+
+// A function to add one hit for each of a run of consecutive ring buffer slots at the row its sample maps to
+// The rows are computed eight samples at a time with vector arithmetic; samples that are NAN or off the panel are skipped
+void phosphor_accumulate(Panel *panel, int slot, int count) {
+    int n = panel->num_points;
+    int height = panel->rect.h;
+    int base = height - SLIDER_WIDTH - SLIDER_PADDING;
+    const float *values = panel->points + slot;
+    uint16_t *hits = panel->hits + slot;
+
+    // Broadcast the mapping of the panel
+    f32x8 min_y, scale, offset, lo, hi;
+    i32x8 top, rows_per_column;
+    for (int j = 0; j < 8; j++) {
+        min_y[j] = panel->min_y;
+        scale[j] = panel->scale;
+        offset[j] = panel->offset;
+        lo[j] = -1.0f - height;
+        hi[j] = 1.0f + 2 * height;
+        top[j] = base;
+        rows_per_column[j] = height;
+    }
+
+    // Map the samples to rows, eight at a time, and add the hits
+    int k = 0;
+    for (; k + 8 <= count; k += 8) {
+        f32x8 v;
+        memcpy(&v, values + k, sizeof(v));
+        f32x8 t = (v - min_y) * scale + offset;
+        i32x8 ok = (v == v) & (t > lo) & (t < hi);
+        t = (f32x8)((i32x8)t & ok);
+        i32x8 row = top - __builtin_convertvector(t, i32x8);
+        ok &= (row >= 0) & (row < rows_per_column);
+        for (int j = 0; j < 8; j++) {
+            if (!ok[j]) continue;
+            uint16_t *h = hits + (size_t)row[j] * n + k + j;
+            if (*h < PHOSPHOR_MAX) (*h)++;
+        }
+    }
+
+    // Map the remaining samples one by one
+    for (; k < count; k++) {
+        float t = (values[k] - panel->min_y) * panel->scale + panel->offset;
+        if (!(t > -1.0f - height && t < 1.0f + 2 * height)) continue;
+        int row = base - (int)t;
+        if (row < 0 || row >= height) continue;
+        uint16_t *h = hits + (size_t)row * n + k;
+        if (*h < PHOSPHOR_MAX) (*h)++;
+    }
+}
+
+// A function to add the samples stored since the last call to the hit counts of a panel
+void phosphor_flush(Panel *panel) {
+    int n = panel->num_points;
+    int pending = panel->hits_pending < n ? panel->hits_pending : n;
+    panel->hits_pending = 0;
+    if (pending == 0) return;
+
+    // The pending samples end just before the write position, possibly wrapping around the ring buffer
+    int start = (panel->index - pending + n) % n;
+    int first = pending < n - start ? pending : n - start;
+    phosphor_accumulate(panel, start, first);
+    if (pending > first) phosphor_accumulate(panel, 0, pending - first);
+}
+
+// A function to decay a run of hit counts by a number of steps, sixteen counts at a time with vector arithmetic
+// Every step takes away a sixteenth of a count, rounded up so that single hits fade out too
+void phosphor_decay(uint16_t *hits, int count, int steps) {
+    if (steps <= 0 || count <= 0) return;
+    if (steps >= PHOSPHOR_CLEAR_STEPS) {
+        memset(hits, 0, count * sizeof(uint16_t));
+        return;
+    }
+    int k = 0;
+    for (; k + 16 <= count; k += 16) {
+        u16x16 h;
+        memcpy(&h, hits + k, sizeof(h));
+        for (int s = 0; s < steps; s++) h -= (h + 15) >> 4;
+        memcpy(hits + k, &h, sizeof(h));
+    }
+    for (; k < count; k++) {
+        for (int s = 0; s < steps; s++) hits[k] -= (hits[k] + 15) >> 4;
+    }
+}
+
+// A function to parse an alarm rule given as "channel:hi=V,lo=V,hyst=V,rate=V,dur=N", returning 0 if it is malformed
+int parse_alarm(const char *spec, AlarmRule *rule) {
+    // Start with no limits, no hysteresis and no minimum duration
+    memset(rule, 0, sizeof(*rule));
+    rule->high = INFINITY;
+    rule->low = -INFINITY;
+    rule->rate = INFINITY;
+    rule->duration = 1;
+
+    // Read the channel, then every key=value pair after the colon
+    char *end;
+    rule->channel = strtol(spec, &end, 10);
+    if (end == spec || *end != ':') return 0;
+    const char *field = end + 1;
+    while (*field != '\0') {
+        const char *equals = strchr(field, '=');
+        if (equals == NULL) return 0;
+        size_t key = equals - field;
+        float value = strtof(equals + 1, &end);
+        if (end == equals + 1 || (*end != ',' && *end != '\0')) return 0;
+        if (key == 2 && strncmp(field, "hi", 2) == 0) rule->high = value;
+        else if (key == 2 && strncmp(field, "lo", 2) == 0) rule->low = value;
+        else if (key == 4 && strncmp(field, "hyst", 4) == 0) rule->hysteresis = value;
+        else if (key == 4 && strncmp(field, "rate", 4) == 0) rule->rate = value;
+        else if (key == 3 && strncmp(field, "dur", 3) == 0) rule->duration = value >= 1.0f ? (int)value : 1;
+        else return 0;
+        field = *end == ',' ? end + 1 : end;
+    }
+    return 1;
+}
+
+// A function to run the alarm log writer: write every new event of the log to the alarm file until told to quit
+void *alarm_writer(void *arg) {
+    (void)arg;
+    static const char *names[NUM_CONDITIONS] = {"high", "low", "rate"};
+    while (1) {
+        sem_wait(&alarm_ready);
+        unsigned long head = atomic_load_explicit(&alarm_head, memory_order_acquire);
+        unsigned long tail = atomic_load_explicit(&alarm_tail, memory_order_relaxed);
+        for (; tail != head; tail++) {
+            const AlarmEvent *event = &alarm_log[tail & (ALARM_LOG_SIZE - 1)];
+            const AlarmRule *rule = &alarm_rules[event->rule];
+            struct tm local;
+            char stamp[32];
+            localtime_r(&event->time.tv_sec, &local);
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+            fprintf(alarm_file, "%s.%03ld %s: %s alarm %s, value %g\n", stamp, event->time.tv_nsec / 1000000, panels[rule->channel].path,
+                names[event->condition], event->raised ? "raised" : "cleared", event->value);
+            atomic_store_explicit(&alarm_tail, tail + 1, memory_order_release);
+        }
+        fflush(alarm_file);
+        if (atomic_load(&alarm_quit)) break;
+    }
+    return NULL;
+}
+
+// A function to open the alarm log ("-" for stderr) and start its writer thread
+int alarm_start(const char *path) {
+    alarm_file = strcmp(path, "-") == 0 ? stderr : fopen(path, "a");
+    if (alarm_file == NULL) {
+        fprintf(stderr, "Failed to open alarm log %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    sem_init(&alarm_ready, 0, 0);
+    if (pthread_create(&alarm_thread, NULL, alarm_writer, NULL) != 0) {
+        fprintf(stderr, "Failed to start alarm log thread: %s\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+// A function to write the remaining alarm events, stop the writer thread and close the alarm log
+void alarm_stop(void) {
+    atomic_store(&alarm_quit, 1);
+    sem_post(&alarm_ready);
+    pthread_join(alarm_thread, NULL);
+    sem_destroy(&alarm_ready);
+    if (alarm_dropped > 0) fprintf(stderr, "%lu alarm events dropped\n", alarm_dropped);
+    if (alarm_file != stderr) fclose(alarm_file);
+}
+
+// A function to post an alarm event to the log without blocking, dropping it if the writer is a whole log behind
+void alarm_post(int rule, int condition, int raised, float value, long seq) {
+    unsigned long head = atomic_load_explicit(&alarm_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&alarm_tail, memory_order_acquire) >= ALARM_LOG_SIZE) {
+        alarm_dropped++;
+        return;
+    }
+    AlarmEvent *event = &alarm_log[head & (ALARM_LOG_SIZE - 1)];
+    clock_gettime(CLOCK_REALTIME, &event->time);
+    event->seq = seq;
+    event->rule = rule;
+    event->condition = condition;
+    event->raised = raised;
+    event->value = value;
+    atomic_store_explicit(&alarm_head, head + 1, memory_order_release);
+    sem_post(&alarm_ready);
+}
+
+// A function to check whether a block of samples can change the state of an alarm rule, eight samples at a time
+// Every condition is reduced to "x * sign > threshold", picked by whether its alarm is raised: while it is not, a sample beyond the limit
+// matters; while it is, a sample back inside the limit by the hysteresis matters. Blocks where no sample matters are skipped
+int alarm_scan(const AlarmRule *rule, const float *values, const float *lows, const float *highs, int len) {
+    // A condition that is counting towards its minimum duration needs every sample
+    for (int c = 0; c < NUM_CONDITIONS; c++) {
+        if (rule->count[c] > 0) return 1;
+    }
+
+    // Broadcast the sign and threshold of every condition
+    float sign[NUM_CONDITIONS], threshold[NUM_CONDITIONS];
+    sign[ALARM_HIGH] = rule->active[ALARM_HIGH] ? -1.0f : 1.0f;
+    threshold[ALARM_HIGH] = rule->active[ALARM_HIGH] ? rule->hysteresis - rule->high : rule->high;
+    sign[ALARM_LOW] = rule->active[ALARM_LOW] ? 1.0f : -1.0f;
+    threshold[ALARM_LOW] = rule->active[ALARM_LOW] ? rule->low + rule->hysteresis : -rule->low;
+    sign[ALARM_RATE] = rule->active[ALARM_RATE] ? -1.0f : 1.0f;
+    threshold[ALARM_RATE] = rule->active[ALARM_RATE] ? rule->hysteresis - rule->rate : rule->rate;
+    f32x8 sh, th, sl, tl, sr, tr;
+    i32x8 magnitude;
+    for (int j = 0; j < 8; j++) {
+        sh[j] = sign[ALARM_HIGH];
+        th[j] = threshold[ALARM_HIGH];
+        sl[j] = sign[ALARM_LOW];
+        tl[j] = threshold[ALARM_LOW];
+        sr[j] = sign[ALARM_RATE];
+        tr[j] = threshold[ALARM_RATE];
+        magnitude[j] = 0x7FFFFFFF;
+    }
 
-// A structure to store a point on the graph
-typedef struct {
-    int x; // The x coordinate
-    float y; // The y coordinate (changed from int to float)
-} Point;
+    // Test the samples eight at a time; NAN samples never match
+    i32x8 matches = {0};
+    int k = 0;
+    for (; k + 8 <= len; k += 8) {
+        f32x8 v, previous, lo, hi;
+        memcpy(&v, values + k + 1, sizeof(v));
+        memcpy(&previous, values + k, sizeof(previous));
+        memcpy(&lo, lows + k, sizeof(lo));
+        memcpy(&hi, highs + k, sizeof(hi));
+        f32x8 change = (f32x8)((i32x8)(v - previous) & magnitude);
+        matches |= (hi * sh > th) | (lo * sl > tl) | (change * sr > tr);
+    }
+    for (int j = 0; j < 8; j++) {
+        if (matches[j]) return 1;
+    }
 
-// A global pointer to store the points on the graph
-Point *points = NULL;
+    // Test the remaining samples one by one
+    for (; k < len; k++) {
+        float change = fabsf(values[k + 1] - values[k]);
+        if (highs[k] * sh[0] > th[0] || lows[k] * sl[0] > tl[0] || change * sr[0] > tr[0]) return 1;
+    }
+    return 0;
+}
 
-// A global variable to store the current index of the points array
-int index = 0;
+// A function to evaluate the alarm rules of a panel on its block of new samples, posting an event whenever an alarm is raised or cleared
+void alarm_check(Panel *panel) {
+    int len = panel->alarm_len;
+    if (len == 0) return;
+    int channel = panel - panels;
+    for (int r = 0; r < num_alarms; r++) {
+        AlarmRule *rule = &alarm_rules[r];
+        if (rule->channel != channel || !alarm_scan(rule, panel->alarm_values, panel->alarm_lows, panel->alarm_highs, len)) continue;
 
-// A global variable to store the current number of points on the graph
-int num_points = 0;
+        // Step the state of every condition through the block, sample by sample
+        for (int k = 0; k < len; k++) {
+            float x[NUM_CONDITIONS] = {panel->alarm_highs[k], panel->alarm_lows[k], fabsf(panel->alarm_values[k + 1] - panel->alarm_values[k])};
+            int beyond[NUM_CONDITIONS] = {x[0] > rule->high, x[1] < rule->low, x[2] > rule->rate};
+            int inside[NUM_CONDITIONS] = {x[0] < rule->high - rule->hysteresis, x[1] > rule->low + rule->hysteresis, x[2] < rule->rate - rule->hysteresis};
+            long seq = panel->sample_seq - len + k;
+            for (int c = 0; c < NUM_CONDITIONS; c++) {
+                if (!rule->active[c]) {
+                    rule->count[c] = beyond[c] ? rule->count[c] + 1 : 0;
+                    if (rule->count[c] >= rule->duration) {
+                        rule->active[c] = 1;
+                        rule->count[c] = 0;
+                        alarm_post(r, c, 1, x[c], seq);
+                    }
+                }
+                else if (inside[c]) {
+                    rule->active[c] = 0;
+                    alarm_post(r, c, 0, x[c], seq);
+                }
+            }
+        }
+    }
 
-// A global variable to store the minimum y value in the points array
-float min_y = 0.0f;
+    // Keep the last sample for the rate of change of the next block
+    panel->alarm_values[0] = panel->alarm_values[len];
+    panel->alarm_len = 0;
+}
 
-// A global variable to store the maximum y value in the points array
-float max_y = 0.0f;
+// A function to add a new point to the ring buffer of a panel, overwriting the oldest one
+// The point is the mean of an aggregated block of samples, whose smallest and largest samples are low and high
+void update_block(Panel *panel, float low, float high, float value) {
+    // Remove the oldest value from the statistics and add the new one
+    WindowStats *stats = &panel->stats;
+    stats_evict(stats, panel->num_points, panel->points[panel->index], stats->seq - panel->num_points);
+    stats_add(stats, panel->num_points, value, low, high);
 
-// A global variable to store the scale factor for mapping y values to window height
-float scale = 1.0f;
+    // Overwrite the oldest value and advance the index of the array
+    panel->points[panel->index] = value;
+    panel->lows[panel->index] = low;
+    panel->highs[panel->index] = high;
 
-// A global variable to store the offset for adjusting vertical position of graph
-float offset = 0.0f;
+    // Retain the sample in the history, overwriting the oldest retained one
+    int slot = panel->sample_seq & (history_size - 1);
+    panel->history[slot] = value;
+    panel->history_lows[slot] = low;
+    panel->history_highs[slot] = high;
+    panel->sample_seq++;
+    panel->index = (panel->index + 1) % panel->num_points;
+    if (--stats->until_recompute <= 0) stats_recompute(panel);
 
-// A global variable to store which slider is active (0 for none, 1 for offset, 2 for zoom)
-int active_slider = 0;
+    // Add the samples to the persistence display before the ring buffer wraps around and overwrites them
+    if (panel->hits != NULL && ++panel->hits_pending == panel->num_points) phosphor_flush(panel);
 
-// A function to initialize the SDL library and create a window and a renderer
-int init(SDL_Window **window, SDL_Renderer **renderer) {
-    // Initialize SDL
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
-        return 0;
+    // Feed the spectrum of the panel, if it has one
+    if (panel->spectrum != NULL && !isnan(value)) spectrum_push(panel->spectrum, value);
+
+    // Queue the sample for the alarm rules of the panel, which are evaluated a block at a time
+    if (panel->has_alarms) {
+        panel->alarm_values[panel->alarm_len + 1] = value;
+        panel->alarm_lows[panel->alarm_len] = low;
+        panel->alarm_highs[panel->alarm_len] = high;
+        if (++panel->alarm_len == ALARM_BLOCK) alarm_check(panel);
     }
 
-    // Create a window
-    *window = SDL_CreateWindow("Rolling Graph", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
-    if (*window == NULL) {
-        fprintf(stderr, "Window could not be created! SDL_Error: %s\n", SDL_GetError());
-        return 0;
+    // Mark the panel for redrawing; the scale is updated once per frame, not once per sample
+    // A paused view only changes when the oldest sample it shows is overwritten in the history
+    if (!paused || panel->sample_seq - history_size > panel->view_end - panel->num_points) panel->dirty = 1;
+}
+
+// A function to add a new value to the ring buffer of a panel, overwriting the oldest one
+void update_points(Panel *panel, float value) { // Changed value type from int to float
+    update_block(panel, value, value, value);
+}
+
+// A function to get the sample shown in a column of a trace panel, with the low and high of its block:
+// from the points array when live, or from the retained history while paused (NAN if it is no longer retained)
+float column_sample(const Panel *panel, int k, float *low, float *high) {
+    if (!paused) {
+        int slot = (panel->index + k) % panel->num_points;
+        *low = panel->lows[slot];
+        *high = panel->highs[slot];
+        return panel->points[slot];
+    }
+    long seq = panel->view_end - panel->num_points + k;
+    if (seq < 0 || seq < panel->sample_seq - history_size) {
+        *low = *high = NAN;
+        return NAN;
+    }
+    int slot = seq & (history_size - 1);
+    *low = panel->history_lows[slot];
+    *high = panel->history_highs[slot];
+    return panel->history[slot];
+}
+
+// A function to move the view of a paused trace panel by a number of samples (negative for older ones),
+// keeping it inside the retained history; the history is never copied, only the end of the view moves
+void pan_view(Panel *panel, long samples) {
+    long newest = panel->sample_seq;
+    long oldest = newest > history_size ? newest - history_size + panel->num_points : panel->num_points;
+    long end = panel->view_end + samples;
+    if (end < oldest) end = oldest;
+    if (end > newest) end = newest;
+    if (end == panel->view_end) return;
+    panel->view_end = end;
+    panel->view_stale = 1;
+    panel->dirty = 1;
+}
+
+// A function to freeze the trace panels at their newest samples, or return them to live
+// Pausing is O(1) per panel: the view only remembers where it ends, while ingest keeps filling the history
+void set_paused(int pause) {
+    if (pause == paused) return;
+    paused = pause;
+    for (int i = 0; i < num_panels; i++) {
+        Panel *panel = &panels[i];
+        panel->view_end = panel->sample_seq;
+        panel->view_stale = 1;
+        panel->dirty = 1;
+
+        // Start the persistence display over, as its hit counts kept growing without fading out while paused
+        if (!paused) phosphor_clear(panel);
     }
+}
 
-    // Create a renderer
-    *renderer = SDL_CreateRenderer(*window, -1, SDL_RENDERER_ACCELERATED);
-    if (*renderer == NULL) {
-        fprintf(stderr, "Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+// A function to rebuild the statistics of the samples a paused trace panel shows, after its view moved
+void view_rebuild(Panel *panel) {
+    WindowStats *stats = &panel->view_stats;
+    stats_reset(stats, panel->num_points);
+    for (int k = 0; k < panel->num_points; k++) {
+        float low, high;
+        float value = column_sample(panel, k, &low, &high);
+
+        // Sum the samples relative to the first one, to avoid cancellation in the variance
+        if (stats->count == 0 && isfinite(value)) stats->shift = value;
+        stats_add(stats, panel->num_points, value, low, high);
+    }
+    panel->view_stale = 0;
+}
+
+// A function to get the current time of the monotonic clock (shared with the helper) in nanoseconds
+long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// A function to remember a batch of samples stored in a panel until it is presented, when tracing
+// Batches beyond TRACE_PENDING are folded into the last one, keeping its (older) timestamps
+void trace_batch(Panel *panel, long long read_ns, long long parse_ns, int samples) {
+    if (samples == 0) return;
+    if (panel->trace_len == TRACE_PENDING) {
+        panel->trace[TRACE_PENDING - 1].samples += samples;
+        return;
+    }
+    panel->trace[panel->trace_len++] = (TraceBatch){read_ns, parse_ns, now_ns(), samples};
+}
+
+// A function to add a latency of a number of samples to a histogram
+void histogram_add(LatencyHistogram *histogram, long long ns, int samples) {
+    int bucket = 0;
+    while (bucket < TRACE_BUCKETS - 1 && ns >= (1000LL << bucket)) bucket++;
+    histogram->counts[bucket] += samples;
+    histogram->total += samples;
+    histogram->sum_ns += (double)ns * samples;
+    if (ns > histogram->max_ns) histogram->max_ns = ns;
+}
+
+// A function to get the upper bound in microseconds of the histogram bucket holding a quantile (0 to 1), capped at the largest latency
+long long histogram_quantile(const LatencyHistogram *histogram, double q) {
+    unsigned long rank = (unsigned long)(q * histogram->total);
+    unsigned long seen = 0;
+    int bucket = 0;
+    while (bucket < TRACE_BUCKETS - 1 && (seen += histogram->counts[bucket]) <= rank) bucket++;
+    long long max_us = histogram->max_ns / 1000;
+    return (1LL << bucket) < max_us ? 1LL << bucket : max_us;
+}
+
+// A function to write a complete event of a tracing stage to the trace file
+void trace_event(const char *name, int panel, long long start_ns, long long end_ns, int samples) {
+    fprintf(trace_file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"samples\":%d}}",
+            name, panel, (start_ns - trace_start_ns) / 1000.0, (end_ns - start_ns) / 1000.0, samples);
+}
+
+// A function to account the batches of all panels as presented: add their latencies to the histograms and the trace file
+void trace_present(void) {
+    long long present_ns = now_ns();
+    for (int i = 0; i < num_panels; i++) {
+        Panel *panel = &panels[i];
+        for (int b = 0; b < panel->trace_len; b++) {
+            TraceBatch *batch = &panel->trace[b];
+            histogram_add(&trace_histograms[STAGE_TRANSPORT], batch->parse_ns - batch->read_ns, batch->samples);
+            histogram_add(&trace_histograms[STAGE_STORE], batch->store_ns - batch->parse_ns, batch->samples);
+            histogram_add(&trace_histograms[STAGE_PRESENT], present_ns - batch->store_ns, batch->samples);
+            histogram_add(&trace_histograms[STAGE_TOTAL], present_ns - batch->read_ns, batch->samples);
+            trace_event("transport", i, batch->read_ns, batch->parse_ns, batch->samples);
+            trace_event("parse+store", i, batch->parse_ns, batch->store_ns, batch->samples);
+            trace_event("wait+present", i, batch->store_ns, present_ns, batch->samples);
+        }
+        panel->trace_len = 0;
+    }
+}
+
+// A function to open the trace file, naming one trace row per input
+int trace_open(const char *path) {
+    trace_file = fopen(path, "w");
+    if (trace_file == NULL) {
+        fprintf(stderr, "Failed to open trace file %s: %s\n", path, strerror(errno));
         return 0;
     }
+    trace_start_ns = now_ns();
+    fprintf(trace_file, "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"rolling_graph_5\"}}");
+    for (int i = 0; i < num_panels; i++) {
+        if (panels[i].kind != PANEL_TRACE) continue;
+        fprintf(trace_file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", i, panels[i].path);
+    }
+    return 1;
+}
 
-    // Return success
+// A function to close the trace file and print the latency histograms of the stages
+void trace_close(void) {
+    static const char *names[NUM_STAGES] = {"read->parse", "parse->store", "store->present", "read->present"};
+    fprintf(trace_file, "\n]\n");
+    fclose(trace_file);
+    fprintf(stderr, "latency per sample   mean(us)  p50(us)  p90(us)  p99(us)  max(us)\n");
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        const LatencyHistogram *histogram = &trace_histograms[stage];
+        if (histogram->total == 0) continue;
+        fprintf(stderr, "%-18s %10.1f %8lld %8lld %8lld %8lld\n", names[stage], histogram->sum_ns / histogram->total / 1000.0,
+                histogram_quantile(histogram, 0.5), histogram_quantile(histogram, 0.9), histogram_quantile(histogram, 0.99), histogram->max_ns / 1000);
+    }
+}
+
+// A function to parse the "min,max,mean,count" fields of a "#b" line aggregated by the helper, returning 0 if they are malformed
+// The line must end after the count, so that nothing else is ever taken for a block
+int parse_block(const char *line, float *low, float *high, float *mean) {
+    char *end;
+    float fields[3];
+    for (int i = 0; i < 3; i++) {
+        fields[i] = strtof(line, &end);
+        if (end == line || *end != ',') return 0;
+        line = end + 1;
+    }
+    strtol(line, &end, 10);
+    if (end == line || *end != '\0') return 0;
+    *low = fields[0];
+    *high = fields[1];
+    *mean = fields[2];
     return 1;
 }
 
-// A function to close the SDL library and destroy the window and the renderer
-void close(SDL_Window *window, SDL_Renderer *renderer) {
-    // Destroy the window and the renderer
-    SDL_DestroyWindow(window);
-    SDL_DestroyRenderer(renderer);
+// A function to parse every complete line of a block of bytes as a CSV value and add it to the points array of a panel
+// Returns the number of bytes parsed; the block must be followed by a writable byte
+// A "#b min,max,mean,count" line is a block of samples aggregated by the helper, added as its mean with its envelope
+// When tracing, a "#t <ns>" line stamped by the helper starts a new batch read at that time
+int parse_values(Panel *panel, char *data, int len) {
+    long long parse_ns = trace_file != NULL ? now_ns() : 0;
+    long long read_ns = parse_ns;
+    int samples = 0;
+    char *line = data;
+    char *newline;
+    data[len] = '\0';
+    while ((newline = memchr(line, '\n', data + len - line)) != NULL) {
+        *newline = '\0';
+        char *end;
+        float value = strtof(line, &end); // Changed atoi to atof
+        float low, high, mean;
+        if (end != line) {
+            update_points(panel, value);
+            samples++;
+        }
+        else if (line[0] == '#' && line[1] == 'b' && parse_block(line + 2, &low, &high, &mean)) {
+            update_block(panel, low, high, mean);
+            panel->aggregated = 1;
+            samples++;
+        }
+        else if (trace_file != NULL && line[0] == '#' && line[1] == 't') {
+            trace_batch(panel, read_ns, parse_ns, samples);
+            read_ns = strtoll(line + 2, NULL, 10);
+            samples = 0;
+        }
+        line = newline + 1;
+    }
+    if (trace_file != NULL) trace_batch(panel, read_ns, parse_ns, samples);
 
-    // Free the points array
-    free(points);
+    // Evaluate the alarm rules on the samples of this read right away, whether or not a frame is drawn
+    if (panel->has_alarms) alarm_check(panel);
+    return line - data;
+}
 
-    // Quit SDL
-    SDL_Quit();
+// A function to accept a producer on the listening socket of a Unix stream input, replacing the previous one
+void accept_input(Panel *panel) {
+    int fd = accept4(panel->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1) return;
+    if (panel->fd != -1) close_input(panel);
+    panel->fd = fd;
+    watch_fd(panel, fd, 0);
 }
 
-// A function to read a line from the standard input and parse it as a CSV value
-float read_value() { // Changed return type from int to float
-    // Declare a buffer to store the line
-    char buffer[256];
+// A function to receive all queued datagrams of a datagram socket input, DGRAM_BATCH per recvmmsg call,
+// and parse each datagram as one or more lines; also counts truncated datagrams and the kernel's drops
+void read_datagrams(Panel *panel) {
+    struct mmsghdr messages[DGRAM_BATCH];
+    struct iovec iovecs[DGRAM_BATCH];
+    char controls[DGRAM_BATCH][CMSG_SPACE(sizeof(uint32_t))];
 
-    // Read a line from the standard input
-    if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
-        fprintf(stderr, "Failed to read from stdin!\n");
-        return -1.0f;
+    // Point each message at its buffer and control space
+    for (int i = 0; i < DGRAM_BATCH; i++) {
+        iovecs[i].iov_base = dgram_buffers[i];
+        iovecs[i].iov_len = DGRAM_SIZE;
+        memset(&messages[i].msg_hdr, 0, sizeof(messages[i].msg_hdr));
+        messages[i].msg_hdr.msg_iov = &iovecs[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = controls[i];
+        messages[i].msg_hdr.msg_controllen = sizeof(controls[i]);
     }
 
-    // Parse the line as a CSV value and return it as a float
-    return atof(buffer); // Changed atoi to atof
+    // Receive batches until the socket is empty
+    int count;
+    do {
+        count = recvmmsg(panel->fd, messages, DGRAM_BATCH, MSG_DONTWAIT, NULL);
+        if (count < 0) {
+            if (errno != EAGAIN && errno != EINTR) fprintf(stderr, "Failed to receive from %s: %s\n", panel->path, strerror(errno));
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            struct msghdr *header = &messages[i].msg_hdr;
+            panel->datagrams++;
+            if (header->msg_flags & MSG_TRUNC) panel->truncated++;
+
+            // Take the kernel's running count of dropped datagrams
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(header); cmsg != NULL; cmsg = CMSG_NXTHDR(header, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                    uint32_t dropped;
+                    memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+                    panel->dropped = dropped;
+                }
+            }
+
+            // Parse the datagram, ending its last line if the producer did not
+            int len = messages[i].msg_len < DGRAM_SIZE ? (int)messages[i].msg_len : DGRAM_SIZE;
+            if (len > 0 && dgram_buffers[i][len - 1] != '\n') dgram_buffers[i][len++] = '\n';
+            parse_values(panel, dgram_buffers[i], len);
+
+            // Reset the lengths that recvmmsg changed for the next batch
+            header->msg_controllen = sizeof(controls[i]);
+        }
+    } while (count == DGRAM_BATCH);
 }
 
-// A function to update the points array with a new value and shift the existing values to the left
-void update_points(float value, int width, int height) { // Changed value type from int to float
-    // Shift the existing values to the left by one position
-    for (int i = 0; i < num_points - 1; i++) {
-        points[i] = points[i + 1];
+// A function to read the available bytes of a panel's input and parse every complete line as a CSV value
+void read_input(Panel *panel) {
+    // Datagram sockets are received in batches, one datagram at a time
+    if (panel->input == INPUT_UDP || panel->input == INPUT_UNIX_DGRAM) {
+        read_datagrams(panel);
+        return;
     }
 
-    // Add the new value to the end of the array
-    points[num_points - 1].x = width - 1;
-    points[num_points - 1].y = value;
+    // Read as many bytes as fit after the incomplete line kept from the previous read
+    ssize_t bytes = read(panel->fd, panel->buffer + panel->buffer_len, sizeof(panel->buffer) - 1 - panel->buffer_len);
+
+    // Close the input at the end of the data or on errors other than "no data available"
+    if (bytes == 0 || (bytes < 0 && errno != EAGAIN && errno != EINTR)) {
+        if (bytes < 0) fprintf(stderr, "Failed to read from %s: %s\n", panel->path, strerror(errno));
+        close_input(panel);
+        return;
+    }
+    if (bytes < 0) return;
+    panel->buffer_len += bytes;
 
-    // Update the index of the array
-    index = (index + 1) % num_points;
+    // Parse each complete line as a float and add it to the points array
+    int parsed = parse_values(panel, panel->buffer, panel->buffer_len);
 
-    // Update the minimum and maximum y values in the array
-    min_y = points[0].y;
-    max_y = points[0].y;
-    for (int i = 1; i < num_points; i++) {
-        if (points[i].y < min_y) min_y = points[i].y;
-        if (points[i].y > max_y) max_y = points[i].y;
+    // Keep the incomplete last line for the next read, dropping it if it fills the whole buffer
+    panel->buffer_len -= parsed;
+    if (panel->buffer_len == (int)sizeof(panel->buffer) - 1) {
+        panel->buffer_len = 0;
     }
+    memmove(panel->buffer, panel->buffer + parsed, panel->buffer_len);
+}
 
-    // Update the scale factor based on the minimum and maximum y values and the window height
-    // Add some padding to avoid drawing on the edges of the window
-    scale = (height - SLIDER_WIDTH - SLIDER_PADDING * 2) / (max_y - min_y);
+// A function to update the minimum and maximum y values of a panel and its scale factor
+void update_scale(Panel *panel) {
+    // Take the minimum and maximum of the values shown from the front of the monotonic queues
+    const WindowStats *stats = paused ? &panel->view_stats : &panel->stats;
+    if (stats->count == 0) return;
+    float lo = stats->min_queue[stats->min_head].value;
+    float hi = stats->max_queue[stats->max_head].value;
+    panel->min_y = lo;
+    panel->max_y = hi;
+
+    // Update the scale factor based on the minimum and maximum y values and the panel height
+    // Add some padding to avoid drawing on the edges of the panel
+    float range = (hi > lo) ? hi - lo : 1.0f;
+    panel->scale = (panel->rect.h - SLIDER_WIDTH - SLIDER_PADDING * 2) / range * panel->zoom;
 }
 
-// A function to draw the graph on the renderer using the points array
-void draw_graph(SDL_Renderer *renderer, int width, int height) {
-    // Set the draw color to the background color
-    SDL_SetRenderDrawColor(renderer, (BACKGROUND_COLOR >> 24) & 0xFF, (BACKGROUND_COLOR >> 16) & 0xFF, (BACKGROUND_COLOR >> 8) & 0xFF, BACKGROUND_COLOR & 0xFF);
+// A function to map a y value of a panel to a vertical pixel coordinate inside the panel
+int map_y(const Panel *panel, float y) {
+    return panel->rect.h - SLIDER_WIDTH - SLIDER_PADDING - (int)((y - panel->min_y) * panel->scale + panel->offset);
+}
 
-    // Clear the renderer with the background color
-    SDL_RenderClear(renderer);
+// A function to lay out the y axis ticks of a trace panel at round values at least TICK_SPACING pixels apart
+// The layout is cached and only recomputed when the mapping from values to rows changes
+void update_ticks(Panel *panel) {
+    TickLayout *ticks = &panel->ticks;
+    if (ticks->min_y == panel->min_y && ticks->max_y == panel->max_y && ticks->scale == panel->scale &&
+        ticks->offset == panel->offset && ticks->height == panel->rect.h) return;
+    ticks->min_y = panel->min_y;
+    ticks->max_y = panel->max_y;
+    ticks->scale = panel->scale;
+    ticks->offset = panel->offset;
+    ticks->height = panel->rect.h;
+    ticks->count = 0;
+    if (!(panel->scale > 0.0f) || !isfinite(panel->scale)) return;
 
-    // Set the draw color to the graph color
-    SDL_SetRenderDrawColor(renderer, (GRAPH_COLOR >> 24) & 0xFF, (GRAPH_COLOR >> 16) & 0xFF, (GRAPH_COLOR >> 8) & 0xFF, GRAPH_COLOR & 0xFF);
+    // Find the values at the bottom and the top of the panel
+    int base = panel->rect.h - SLIDER_WIDTH - SLIDER_PADDING;
+    double bottom = panel->min_y + (base - panel->rect.h - panel->offset) / panel->scale;
+    double top = panel->min_y + (base - panel->offset) / panel->scale;
 
-    // Draw a line for each pair of consecutive points in the array
-    // Use the scale factor and offset to map y values to window height
-    // Skip drawing lines that involve NAN values
-    for (int i = index; i < num_points - 1; i++) {
-        if (!isnan(points[i].y) && !isnan(points[i + 1].y)) { // Added check for NAN values
-            SDL_RenderDrawLine(renderer, points[i].x, height - SLIDER_WIDTH - SLIDER_PADDING - (int)((points[i].y - min_y) * scale + offset), points[i + 1].x, height - SLIDER_WIDTH - SLIDER_PADDING - (int)((points[i + 1].y - min_y) * scale + offset)); // Cast y values to int
-        }
+    // Pick the smallest step of 1, 2 or 5 times a power of ten that is at least TICK_SPACING pixels,
+    // then widen it until all the ticks of the panel fit in MAX_TICKS, so that tall panels keep their axis up to the top
+    static const double mantissas[] = {1.0, 2.0, 5.0};
+    double raw = TICK_SPACING / panel->scale;
+    double power = pow(10.0, floor(log10(raw)));
+    int m = 0;
+    while (m < 3 && mantissas[m] * power < raw) m++;
+    if (m == 3) {
+        m = 0;
+        power *= 10.0;
     }
-    
-     for (int i = 0; i < index - 1; i++) {
-        if (!isnan(points[i].y) && !isnan(points[i + 1].y)) { // Added check for NAN values
-            SDL_RenderDrawLine(renderer, points[i].x - width, height - SLIDER_WIDTH - SLIDER_PADDING - (int)((points[i].y - min_y) * scale + offset), points[i + 1].x - width, height - SLIDER_WIDTH - SLIDER_PADDING - (int)((points[i + 1].y - min_y) * scale + offset)); // Cast y values to int
+    while ((top - bottom) / (mantissas[m] * power) >= MAX_TICKS) {
+        if (++m == 3) {
+            m = 0;
+            power *= 10.0;
         }
     }
+    double step = mantissas[m] * power;
+
+    // Give the labels as many decimals as the step needs, so that neighbouring ticks never share a label
+    // Very large or very small magnitudes use exponents instead, with enough significant digits to tell the ticks apart
+    int decimals = (int)-floor(log10(step));
+    double magnitude = fmax(fabs(bottom), fabs(top));
+    int fixed = magnitude < 1e7 && decimals <= 6;
+    if (decimals < 0) decimals = 0;
+    int digits = magnitude > step ? (int)floor(log10(magnitude)) - (int)floor(log10(step)) + 1 : 1;
+    if (digits > 9) digits = 9;
+
+    // Put a tick on every multiple of the step between the bottom and the top
+    for (double v = ceil(bottom / step) * step; v <= top && ticks->count < MAX_TICKS; v += step) {
+        if (fabs(v) < step * 1e-6) v = 0.0;
+        ticks->rows[ticks->count] = map_y(panel, v);
+        if (fixed) snprintf(ticks->labels[ticks->count], TICK_LABEL, "%.*f", decimals, v);
+        else snprintf(ticks->labels[ticks->count], TICK_LABEL, "%.*g", digits, v);
+        ticks->count++;
+    }
+}
 
-    // Set the draw color to the slider color or slider active color depending on which slider is active
-    if (active_slider == 1) {
-        SDL_SetRenderDrawColor(renderer, (SLIDER_ACTIVE_COLOR >> 24) & 0xFF, (SLIDER_ACTIVE_COLOR >> 16) & 0xFF, (SLIDER_ACTIVE_COLOR >> 8) & 0xFF, SLIDER_ACTIVE_COLOR & 0xFF);
+// A function to format the current value readout of a trace panel and, if the mouse is over it, the value under the cursor
+// While paused, the readout also gives how many samples the newest one shown is behind the newest one received
+// The x of the cursor counts samples back from the newest one received
+void update_readout(Panel *panel) {
+    int n = panel->num_points;
+    long behind = paused ? panel->sample_seq - panel->view_end : 0;
+    float low, high;
+    float newest = column_sample(panel, n - 1, &low, &high);
+    if (paused) snprintf(panel->readout, sizeof(panel->readout), "x=%ld y=%g", -behind, newest);
+    else snprintf(panel->readout, sizeof(panel->readout), "y=%g", newest);
+    if (panel == hover_panel && hover_x >= 0 && hover_x < n) {
+        snprintf(panel->hover_readout, sizeof(panel->hover_readout), "x=%ld y=%g", hover_x - (n - 1) - behind, column_sample(panel, hover_x, &low, &high));
     }
-    else {
-        SDL_SetRenderDrawColor(renderer, (SLIDER_COLOR >> 24) & 0xFF, (SLIDER_COLOR >> 16) & 0xFF, (SLIDER_COLOR >> 8) & 0xFF, SLIDER_COLOR & 0xFF);
+}
+
+// A function to draw a horizontal line across a panel at a y value
+void draw_level(Canvas *canvas, const Panel *panel, float y, Uint32 color) {
+    canvas_set_color(canvas, color);
+    canvas_fill_rect(canvas, 0, map_y(panel, y), panel->rect.w, 1);
+}
+
+// A function to draw the statistics overlay of a panel: the mean +/- one standard deviation band, the mean, the RMS and the p5 and p95 levels
+void draw_stats(Canvas *canvas, const Panel *panel) {
+    const WindowStats *stats = paused ? &panel->view_stats : &panel->stats;
+    if (stats->count == 0) return;
+
+    // Derive the mean, standard deviation and RMS from the shifted sums
+    double mean_shifted = stats->sum / stats->count;
+    double variance = stats->sum_sq / stats->count - mean_shifted * mean_shifted;
+    double mean = stats->shift + mean_shifted;
+    double sigma = variance > 0.0 ? sqrt(variance) : 0.0;
+    double rms = sqrt((variance > 0.0 ? variance : 0.0) + mean * mean);
+
+    // Draw the translucent band behind the other levels
+    int top = map_y(panel, mean + sigma);
+    int bottom = map_y(panel, mean - sigma);
+    canvas_set_color(canvas, STATS_BAND_COLOR);
+    canvas_fill_rect(canvas, 0, top, panel->rect.w, bottom - top + 1);
+
+    // Draw the levels
+    draw_level(canvas, panel, mean, STATS_MEAN_COLOR);
+    draw_level(canvas, panel, rms, STATS_RMS_COLOR);
+    draw_level(canvas, panel, stats_quantile(stats, 0.05f), STATS_PERCENTILE_COLOR);
+    draw_level(canvas, panel, stats_quantile(stats, 0.95f), STATS_PERCENTILE_COLOR);
+}
+
+// A function to decay and draw the hit counts of a trace panel, for the columns inside the canvas
+// Every column is decayed by exactly one strip, so the work per frame only depends on the panel size
+void draw_phosphor(Canvas *canvas, const Panel *panel) {
+    int n = panel->num_points;
+    int left = canvas->clip.x - panel->rect.x;
+    int count = canvas->clip.w;
+    if (count <= 0) return;
+
+    // The columns of the canvas show a run of ring buffer slots starting after the oldest sample, possibly wrapping around
+    int start = (panel->index + left) % n;
+    int first = count < n - start ? count : n - start;
+
+    // Decay and color map each row of the panel
+    for (int y = canvas->clip.y; y < canvas->clip.y + canvas->clip.h; y++) {
+        uint16_t *hits = panel->hits + (size_t)(y - panel->rect.y) * n;
+        phosphor_decay(hits + start, first, phosphor_steps);
+        phosphor_decay(hits, count - first, phosphor_steps);
+        Uint32 *p = canvas->pixels + (size_t)y * canvas->pitch + canvas->clip.x;
+        for (int k = 0; k < first; k++) p[k] = phosphor_palette[phosphor_levels[hits[start + k]]];
+        for (int k = first; k < count; k++) p[k] = phosphor_palette[phosphor_levels[hits[k - first]]];
+    }
+}
+
+// A function to draw the horizontal grid lines of a trace panel at its ticks
+void draw_grid(Canvas *canvas, const Panel *panel) {
+    canvas_set_color(canvas, GRID_COLOR);
+    for (int i = 0; i < panel->ticks.count; i++) {
+        canvas_fill_rect(canvas, 0, panel->ticks.rows[i], panel->rect.w, 1);
+    }
+}
+
+// A function to draw the tick labels, the current value readout and the hover cursor of a trace panel
+void draw_labels(Canvas *canvas, const Panel *panel) {
+    // Draw the tick labels at the left edge, centered on their grid lines, above the offset slider
+    int bottom = panel->rect.h - SLIDER_WIDTH - SLIDER_PADDING * 2;
+    canvas_set_color(canvas, LABEL_COLOR);
+    for (int i = 0; i < panel->ticks.count; i++) {
+        int y = panel->ticks.rows[i] - FONT_HEIGHT / 2;
+        if (y >= 0 && y + FONT_HEIGHT <= bottom) canvas_draw_text(canvas, 2, y, panel->ticks.labels[i]);
+    }
+
+    // Draw the newest value at the top right, left of the zoom slider, after a pause sign while paused
+    int right = panel->rect.w - SLIDER_WIDTH - SLIDER_PADDING * 2;
+    int left = right - (int)strlen(panel->readout) * FONT_WIDTH;
+    canvas_draw_text(canvas, left, 2, panel->readout);
+    if (paused) {
+        canvas_fill_rect(canvas, left - 10, 2, 2, FONT_HEIGHT - 1);
+        canvas_fill_rect(canvas, left - 6, 2, 2, FONT_HEIGHT - 1);
+    }
+
+    // Draw the cursor line and the value under it, next to the line and inside the panel
+    if (panel == hover_panel && hover_x >= 0 && hover_x < panel->rect.w) {
+        canvas_set_color(canvas, CURSOR_COLOR);
+        canvas_fill_rect(canvas, hover_x, 0, 1, panel->rect.h);
+        int width = (int)strlen(panel->hover_readout) * FONT_WIDTH;
+        int x = hover_x + 4 + width <= right ? hover_x + 4 : hover_x - 4 - width;
+        canvas_set_color(canvas, LABEL_COLOR);
+        canvas_draw_text(canvas, x, FONT_HEIGHT + 6, panel->hover_readout);
+    }
+}
+
+// A function to draw a marker at every alarm event of a trace panel that is in the samples it shows, from the event log
+void draw_alarms(Canvas *canvas, const Panel *panel) {
+    if (!panel->has_alarms) return;
+    int channel = panel - panels;
+    long end = paused ? panel->view_end : panel->sample_seq;
+    unsigned long head = atomic_load_explicit(&alarm_head, memory_order_acquire);
+    unsigned long oldest = head > ALARM_LOG_SIZE ? head - ALARM_LOG_SIZE : 0;
+    for (unsigned long i = head; i > oldest; i--) {
+        const AlarmEvent *event = &alarm_log[(i - 1) & (ALARM_LOG_SIZE - 1)];
+        if (alarm_rules[event->rule].channel != channel) continue;
+        long age = end - 1 - event->seq;
+        if (age < 0) continue;
+        if (age >= panel->num_points) break;
+        int x = panel->num_points - 1 - (int)age;
+        canvas_set_color(canvas, event->raised ? ALARM_RAISED_COLOR : ALARM_CLEARED_COLOR);
+        canvas_fill_rect(canvas, x, 0, 1, panel->rect.h);
+        canvas_fill_rect(canvas, x - 2, 0, 5, 5);
     }
+}
 
-    // Draw a rectangle for the offset slider at the bottom of the window
-    SDL_Rect offset_slider = {SLIDER_PADDING, height - SLIDER_WIDTH - SLIDER_PADDING, width - SLIDER_PADDING * 2, SLIDER_WIDTH};
-    SDL_RenderFillRect(renderer, &offset_slider);
+// A function to draw one panel of the graph on a canvas, in the coordinates of the panel
+void draw_graph(Canvas *canvas, const Panel *panel) {
+    int width = panel->rect.w;
+    int height = panel->rect.h;
 
-     // Set the draw color to the slider color or slider active color depending on which slider is active
-     if (active_slider == 2) {
-        SDL_SetRenderDrawColor(renderer, (SLIDER_ACTIVE_COLOR >> 24) & 0xFF, (SLIDER_ACTIVE_COLOR >> 16) & 0xFF, (SLIDER_ACTIVE_COLOR >> 8) & 0xFF, SLIDER_ACTIVE_COLOR & 0xFF);
+    // Restrict drawing to the panel and clear it with the background color, or draw the persistence display in its place
+    canvas_set_viewport(canvas, &panel->rect);
+    int phosphor = panel->hits != NULL && show_persistence && canvas->pixels != NULL && !paused;
+    if (phosphor) {
+        draw_phosphor(canvas, panel);
     }
     else {
-        SDL_SetRenderDrawColor(renderer, (SLIDER_COLOR >> 24) & 0xFF, (SLIDER_COLOR >> 16) & 0xFF, (SLIDER_COLOR >> 8) & 0xFF, SLIDER_COLOR & 0xFF);
+        canvas_set_color(canvas, BACKGROUND_COLOR);
+        canvas_fill_rect(canvas, 0, 0, width, height);
+    }
+
+    // Draw the grid and the statistics overlay behind the samples
+    draw_grid(canvas, panel);
+    if (show_stats) draw_stats(canvas, panel);
+
+    // Draw the samples from the oldest to the newest shown, one per pixel column
+    // Only visit the columns inside the canvas, plus one on each side for the segments crossing its edges
+    // Use the scale factor and offset to map y values to panel height
+    // Draw each run of consecutive non-NAN values with a single call
+    canvas_set_color(canvas, GRAPH_COLOR);
+    SDL_Point *vertices = canvas->vertices;
+    int first = canvas->clip.x - panel->rect.x - 1;
+    int last = canvas->clip.x + canvas->clip.w - panel->rect.x + 1;
+    if (first < 0) first = 0;
+    if (last > panel->num_points) last = panel->num_points;
+    if (phosphor) last = first;
+
+    // Draw the span between the smallest and largest sample of every aggregated point behind the line, so that spikes stay visible
+    if (panel->aggregated) {
+        canvas_set_color(canvas, ENVELOPE_COLOR);
+        for (int k = first; k < last; k++) {
+            float low, high;
+            column_sample(panel, k, &low, &high);
+            if (isnan(low) || !(high > low)) continue;
+            int top = map_y(panel, high);
+            canvas_fill_rect(canvas, k, top, 1, map_y(panel, low) - top + 1);
+        }
+        canvas_set_color(canvas, GRAPH_COLOR);
+    }
+
+    int run = 0;
+    for (int k = first; k < last; k++) {
+        float low, high;
+        float y = column_sample(panel, k, &low, &high);
+        if (!isnan(y)) { // Added check for NAN values
+            vertices[run].x = k;
+            vertices[run].y = map_y(panel, y);
+            run++;
+        }
+        if ((isnan(y) || k == last - 1) && run > 0) {
+            if (run > 1) canvas_draw_lines(canvas, vertices, run);
+            run = 0;
+        }
+    }
+
+    // Draw the alarm markers, the tick labels and the readouts over the samples
+    draw_alarms(canvas, panel);
+    draw_labels(canvas, panel);
+
+    // Draw a rectangle for the offset slider at the bottom of the panel, highlighted if it is active
+    canvas_set_color(canvas, panel->active_slider == 1 ? SLIDER_ACTIVE_COLOR : SLIDER_COLOR);
+    canvas_fill_rect(canvas, SLIDER_PADDING, height - SLIDER_WIDTH - SLIDER_PADDING, width - SLIDER_PADDING * 2, SLIDER_WIDTH);
+
+    // Draw a rectangle for the zoom slider at the right of the panel, highlighted if it is active
+    canvas_set_color(canvas, panel->active_slider == 2 ? SLIDER_ACTIVE_COLOR : SLIDER_COLOR);
+    canvas_fill_rect(canvas, width - SLIDER_WIDTH - SLIDER_PADDING, SLIDER_PADDING, SLIDER_WIDTH, height - SLIDER_WIDTH - SLIDER_PADDING * 3);
+}
+
+// A function to draw a spectrum panel: the magnitudes from DC on the left to half the sample rate on the right,
+// taking the highest bin of each pixel column, over a fixed dynamic range below the highest bin
+void draw_spectrum(Canvas *canvas, const Panel *panel) {
+    Spectrum *spectrum = panel->spectrum;
+    int width = panel->rect.w;
+    int height = panel->rect.h;
+    int num_bins = spectrum->size / 2 + 1;
+
+    // Restrict drawing to the panel and clear it with the background color
+    canvas_set_viewport(canvas, &panel->rect);
+    canvas_set_color(canvas, BACKGROUND_COLOR);
+    canvas_fill_rect(canvas, 0, 0, width, height);
+
+    // Find the highest bin to anchor the dynamic range
+    float top = -INFINITY;
+    for (int k = 0; k < num_bins; k++) {
+        if (spectrum->display[k] > top) top = spectrum->display[k];
+    }
+
+    // Draw one vertex per pixel column at the highest bin falling into it, for the columns inside the canvas
+    canvas_set_color(canvas, SPECTRUM_COLOR);
+    SDL_Point *vertices = canvas->vertices;
+    int left = canvas->clip.x - panel->rect.x - 1;
+    int right = canvas->clip.x + canvas->clip.w - panel->rect.x + 1;
+    if (left < 0) left = 0;
+    if (right > width) right = width;
+    for (int x = left; x < right; x++) {
+        int first = (int)((long)x * num_bins / width);
+        int last = (int)((long)(x + 1) * num_bins / width);
+        float db = spectrum->display[first];
+        for (int k = first + 1; k < last; k++) {
+            if (spectrum->display[k] > db) db = spectrum->display[k];
+        }
+        float level = (db - top + SPECTRUM_RANGE_DB) / SPECTRUM_RANGE_DB;
+        if (level < 0.0f) level = 0.0f;
+        vertices[x - left].x = x;
+        vertices[x - left].y = height - 1 - (int)(level * (height - 1));
+    }
+    if (right - left > 1) canvas_draw_lines(canvas, vertices, right - left);
+}
+
+// A function to draw the panels overlapping a canvas, clipped to it
+void draw_strip(Canvas *canvas) {
+    // Clear the canvas with the gap color
+    canvas_clear(canvas, PANEL_GAP_COLOR);
+
+    // Draw every panel that overlaps the canvas in its own area
+    for (int i = 0; i < num_panels; i++) {
+        const SDL_Rect *r = &panels[i].rect;
+        if (r->x >= canvas->bounds.x + canvas->bounds.w || r->x + r->w <= canvas->bounds.x) continue;
+        if (panels[i].kind == PANEL_SPECTRUM) draw_spectrum(canvas, &panels[i]);
+        else draw_graph(canvas, &panels[i]);
+    }
+}
+
+// A function to run a strip worker: rasterize its strip every time the main thread starts a frame
+void *strip_thread(void *arg) {
+    Canvas *canvas = arg;
+    while (1) {
+        pthread_barrier_wait(&frame_start);
+        if (strips_quit) break;
+        draw_strip(canvas);
+        pthread_barrier_wait(&frame_done);
+    }
+    return NULL;
+}
+
+// A function to start the strip workers, one thread per strip after the first one
+int start_strips(int count) {
+    if (count < 1) count = 1;
+    if (count > MAX_STRIPS) count = MAX_STRIPS;
+    num_strips = count;
+    if (num_strips == 1) return 1;
+
+    // Create the barriers, which the main thread passes too
+    pthread_barrier_init(&frame_start, NULL, num_strips);
+    pthread_barrier_init(&frame_done, NULL, num_strips);
+
+    // Start the workers
+    for (int i = 1; i < num_strips; i++) {
+        if (pthread_create(&strip_threads[i], NULL, strip_thread, &strips[i]) != 0) {
+            fprintf(stderr, "Failed to start raster thread: %s\n", strerror(errno));
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// A function to stop the strip workers and wait for them to exit
+void stop_strips(void) {
+    if (num_strips == 1) return;
+    strips_quit = 1;
+    pthread_barrier_wait(&frame_start);
+    for (int i = 1; i < num_strips; i++) pthread_join(strip_threads[i], NULL);
+    pthread_barrier_destroy(&frame_start);
+    pthread_barrier_destroy(&frame_done);
+}
+
+// A function to draw all panels and present them on the window with a single present
+// With the software rasterizer, the panels are drawn into the locked framebuffer texture, one vertical strip per thread,
+// and the texture is copied to the window once all strips are done
+void draw_panels(SDL_Renderer *renderer) {
+    // Update the scale of the trace panels and add their new samples to the persistence displays before any strip reads them
+    for (int i = 0; i < num_panels; i++) {
+        if (panels[i].kind == PANEL_TRACE) {
+            // Keep a paused view inside the retained history and rebuild its statistics after it moved
+            if (paused) {
+                pan_view(&panels[i], 0);
+                if (panels[i].view_stale) view_rebuild(&panels[i]);
+            }
+            update_scale(&panels[i]);
+            update_ticks(&panels[i]);
+            update_readout(&panels[i]);
+        }
+        if (panels[i].hits != NULL) phosphor_flush(&panels[i]);
+        panels[i].dirty = 0;
+    }
+
+    // Count the decay steps of the persistence displays due since the last frame
+    Uint32 now = SDL_GetTicks();
+    phosphor_steps = (now - phosphor_decayed) / PHOSPHOR_DECAY_MS;
+    phosphor_decayed += phosphor_steps * PHOSPHOR_DECAY_MS;
+
+    // Draw with the renderer through the only canvas, which covers the whole window
+    if (framebuffer == NULL) {
+        draw_strip(&strips[0]);
     }
+    else {
+        // Lock the framebuffer and let every strip draw into its pixels
+        void *pixels;
+        int pitch;
+        if (SDL_LockTexture(framebuffer, NULL, &pixels, &pitch) != 0) {
+            fprintf(stderr, "Failed to lock framebuffer! SDL_Error: %s\n", SDL_GetError());
+            return;
+        }
+        for (int i = 0; i < num_strips; i++) {
+            strips[i].pixels = pixels;
+            strips[i].pitch = pitch / sizeof(Uint32);
+        }
 
-    // Draw a rectangle for the zoom slider at the right of the window
-    SDL_Rect zoom_slider = {width - SLIDER_WIDTH - SLIDER_PADDING, SLIDER_PADDING, SLIDER_WIDTH, height - SLIDER_WIDTH - SLIDER_PADDING * 3};
-    SDL_RenderFillRect(renderer, &zoom_slider);
+        // Start the workers, rasterize the first strip here and wait for all strips before unlocking
+        if (num_strips > 1) pthread_barrier_wait(&frame_start);
+        draw_strip(&strips[0]);
+        if (num_strips > 1) pthread_barrier_wait(&frame_done);
+
+        // Unlock the framebuffer and copy it to the window
+        SDL_UnlockTexture(framebuffer);
+        for (int i = 0; i < num_strips; i++) strips[i].pixels = NULL;
+        SDL_RenderSetViewport(renderer, NULL);
+        SDL_RenderCopy(renderer, framebuffer, NULL, NULL);
+    }
 
     // Present the renderer on the window
     SDL_RenderPresent(renderer);
+
+    // Account the samples drawn in this frame as presented
+    if (trace_file != NULL) trace_present();
 }
 
-// A function to resize the points array and update their coordinates according to the new window size
-void resize_points(int width, int height) {
-    // Calculate the new number of points based on the window width
-    int new_num_points = width;
+// A function to resize the points array of a panel and its envelope, keeping the newest samples
+void resize_points(Panel *panel, int new_num_points) {
+    if (new_num_points < 1) new_num_points = 1;
+
+    // Resize the ring buffers of the points and of their lows and highs the same way
+    float **rings[] = {&panel->points, &panel->lows, &panel->highs};
+    for (int r = 0; r < 3; r++) {
+        // Allocate a new array for the points
+        float *new_points = malloc(new_num_points * sizeof(float));
+
+        // Initialize the new array with NAN values
+        for (int i = 0; i < new_num_points; i++) {
+            new_points[i] = NAN; // Use NAN macro to assign NAN value
+        }
+
+        // Copy the newest existing points to the end of the new array, from the oldest to the newest
+        float *old_points = *rings[r];
+        int keep = panel->num_points < new_num_points ? panel->num_points : new_num_points;
+        for (int k = 0; k < keep; k++) {
+            new_points[new_num_points - keep + k] = old_points[(panel->index + panel->num_points - keep + k) % panel->num_points];
+        }
+
+        // Free the old array and assign the new array to the panel
+        free(old_points);
+        *rings[r] = new_points;
+    }
+    panel->num_points = new_num_points;
+    panel->index = 0;
 
-    // Allocate a new array for the points
-    Point *new_points = malloc(new_num_points * sizeof(Point));
+    // Rebuild the windowed statistics for the new window, and those of a paused view on the next frame
+    stats_rebuild(panel);
+    panel->view_stale = 1;
+}
 
-    // Initialize the new array with NAN values
-    for (int i = 0; i < new_num_points; i++) {
-        new_points[i].x = i;
-        new_points[i].y = NAN; // Use NAN macro to assign NAN value
+// A function to (re)create the streaming framebuffer texture of the software rasterizer at the window size
+int create_framebuffer(SDL_Renderer *renderer, int width, int height) {
+    if (framebuffer != NULL) SDL_DestroyTexture(framebuffer);
+    framebuffer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (framebuffer == NULL) {
+        fprintf(stderr, "Framebuffer could not be created! SDL_Error: %s\n", SDL_GetError());
+        return 0;
     }
+    return 1;
+}
 
-    // Copy the existing points to the new array and scale their coordinates
-    for (int i = 0; i < num_points; i++) {
-        new_points[i].x = points[i].x * width / WINDOW_WIDTH;
-        new_points[i].y = points[i].y * height / WINDOW_HEIGHT;
+// A function to lay out the panels in a grid covering the window and resize their points arrays
+void layout_panels(int width, int height) {
+    // Use a grid that is as square as possible
+    int cols = (int)ceil(sqrt(num_panels));
+    int rows = (num_panels + cols - 1) / cols;
+
+    // Give every panel its share of the window, minus the gaps
+    for (int i = 0; i < num_panels; i++) {
+        int col = i % cols;
+        int row = i / cols;
+        Panel *panel = &panels[i];
+        panel->rect.x = col * width / cols + PANEL_GAP / 2;
+        panel->rect.y = row * height / rows + PANEL_GAP / 2;
+        panel->rect.w = (col + 1) * width / cols - col * width / cols - PANEL_GAP;
+        panel->rect.h = (row + 1) * height / rows - row * height / rows - PANEL_GAP;
+        if (panel->kind == PANEL_TRACE) resize_points(panel, panel->rect.w);
+        if (panel->kind == PANEL_TRACE && persistence) phosphor_resize(panel);
+        panel->dirty = 1;
     }
 
-    // Free the old array and assign the new array to the global pointer
-    free(points);
-    points = new_points;
+    // Split the window into one vertical strip per canvas and grow their scratch arrays of line vertices to the widest panel
+    for (int i = 0; i < num_strips; i++) {
+        Canvas *strip = &strips[i];
+        strip->bounds = (SDL_Rect){i * width / num_strips, 0, (i + 1) * width / num_strips - i * width / num_strips, height};
+        if (width > strip->capacity) {
+            free(strip->vertices);
+            strip->vertices = malloc(width * sizeof(SDL_Point));
+            strip->capacity = width;
+        }
+    }
+}
 
-    // Update the global variable for the number of points
-    num_points = new_num_points;
+// A function to find the panel under a window position
+Panel *panel_at(int x, int y) {
+    for (int i = 0; i < num_panels; i++) {
+        SDL_Rect *r = &panels[i].rect;
+        if (panels[i].kind == PANEL_TRACE && x >= r->x && x < r->x + r->w && y >= r->y && y < r->y + r->h) return &panels[i];
+    }
+    return NULL;
 }
 
 // The main function of the program
 int main(int argc, char *argv[]) {
+    // Declare variables to store the channels that get a spectrum panel and the FFT parameters
+    int spectrum_channels[MAX_PANELS];
+    int num_spectra = 0;
+    int fft_size = FFT_SIZE;
+    int fft_hop = 0;
+
+    // Declare variables to store the serial ports and sockets to read, in command line order, and the serial baud rate
+    int source_inputs[MAX_PANELS];
+    const char *source_paths[MAX_PANELS];
+    int num_sources = 0;
+    speed_t serial_baud = SERIAL_BAUD;
+
+    // Declare a variable to store the path of the latency trace file
+    const char *trace_path = NULL;
+
+    // Declare a variable to store the number of software raster threads (0 for one per CPU)
+    int raster_threads = 0;
+
+    // Declare a variable to store the path of the alarm log ("-" for stderr)
+    const char *alarm_path = "-";
+
+    // Declare the long command line options
+    static const struct option options[] = {
+        {"spectrum", required_argument, NULL, 's'},
+        {"fft-size", required_argument, NULL, 'n'},
+        {"fft-hop", required_argument, NULL, 'o'},
+        {"serial", required_argument, NULL, 'd'},
+        {"baud", required_argument, NULL, 'b'},
+        {"unix", required_argument, NULL, 'u'},
+        {"unix-dgram", required_argument, NULL, 'g'},
+        {"udp", required_argument, NULL, 'p'},
+        {"trace", required_argument, NULL, 'T'},
+        {"software", no_argument, NULL, 'R'},
+        {"threads", required_argument, NULL, 'j'},
+        {"persistence", no_argument, NULL, 'P'},
+        {"alarm", required_argument, NULL, 'A'},
+        {"alarm-log", required_argument, NULL, 'L'},
+        {"history", required_argument, NULL, 'H'},
+        {NULL, 0, NULL, 0}
+    };
+
+    // Parse the command line options using getopt_long
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:n:o:d:b:u:g:p:T:Rj:PA:L:H:", options, NULL)) != -1) {
+        switch (opt) {
+            case 's': // Spectrum option: the input channel (0 for the first input) to show the spectrum of
+                if (num_spectra == MAX_PANELS) {
+                    fprintf(stderr, "Too many spectra, at most %d are supported!\n", MAX_PANELS);
+                    return 1;
+                }
+                spectrum_channels[num_spectra++] = atoi(optarg);
+                break;
+            case 'n': // FFT size option, rounded up to a power of two
+                fft_size = 4;
+                while (fft_size < atoi(optarg) && fft_size < FFT_MAX_SIZE) fft_size <<= 1;
+                break;
+            case 'o': // FFT hop option: the number of new samples between two FFTs
+                fft_hop = atoi(optarg);
+                break;
+            case 'd': // Serial device option: a serial port to read directly, as its own panel
+            case 'u': // Unix stream socket option: a socket path to listen on for a producer
+            case 'g': // Unix datagram socket option: a socket path to receive datagrams on
+            case 'p': // UDP option: a port on loopback to receive datagrams on
+                if (num_sources == MAX_PANELS) {
+                    fprintf(stderr, "Too many inputs, at most %d are supported!\n", MAX_PANELS);
+                    return 1;
+                }
+                source_inputs[num_sources] = opt == 'd' ? INPUT_SERIAL : opt == 'u' ? INPUT_UNIX_STREAM : opt == 'g' ? INPUT_UNIX_DGRAM : INPUT_UDP;
+                source_paths[num_sources++] = optarg;
+                break;
+            case 'b': // Baud rate option for all serial ports, mapped to its termios speed constant
+                serial_baud = baud_to_speed(atoi(optarg));
+                if (serial_baud == B0) {
+                    fprintf(stderr, "Unsupported baud rate %s!\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'T': // Trace option: the Chrome trace file to write the latency of every batch of samples to
+                trace_path = optarg;
+                break;
+            case 'R': // Software option: rasterize into a streaming texture even if the renderer is accelerated
+                software_raster = 1;
+                break;
+            case 'j': // Threads option: the number of vertical strips rasterized in parallel
+                raster_threads = atoi(optarg);
+                break;
+            case 'P': // Persistence option: draw a decaying density of the samples, which needs the software rasterizer
+                persistence = 1;
+                software_raster = 1;
+                break;
+            case 'A': // Alarm option: a rule "channel:hi=V,lo=V,hyst=V,rate=V,dur=N" (any subset of the keys)
+                if (num_alarms == MAX_ALARMS || !parse_alarm(optarg, &alarm_rules[num_alarms])) {
+                    fprintf(stderr, "Invalid alarm rule %s!\n", optarg);
+                    return 1;
+                }
+                num_alarms++;
+                break;
+            case 'L': // Alarm log option: the file the alarm events are appended to
+                alarm_path = optarg;
+                break;
+            case 'H': // History option: the number of samples retained per input for scrollback, rounded up to a power of two
+                history_size = 1024;
+                while (history_size < atol(optarg) && history_size < (1 << 30)) history_size <<= 1;
+                break;
+            default: // Invalid option or missing argument
+                fprintf(stderr, "Usage: %s [-d serial_device]... [-b baud] [-u unix_socket]... [-g unix_dgram_socket]... [-p udp_port]... [-s channel] [-n fft_size] [-o fft_hop] [-T trace_file] [-R] [-j threads] [-P] [-A alarm_rule]... [-L alarm_log] [-H history] [path...]\n", argv[0]); // Print usage message and exit
+                return 1;
+        }
+    }
+    if (fft_hop <= 0 || fft_hop > fft_size) fft_hop = fft_size / 4;
+
+    // Create one panel per serial port or socket, then one per input path given on the command line,
+    // or a single panel for stdin if there are neither
+    for (int i = 0; i < num_sources; i++) {
+        Panel *panel = &panels[num_panels++];
+        panel->kind = PANEL_TRACE;
+        panel->input = source_inputs[i];
+        panel->path = source_paths[i];
+        panel->baud = serial_baud;
+        panel->fd = -1;
+        panel->listen_fd = -1;
+        panel->scale = 1.0f;
+        panel->zoom = 1.0f;
+    }
+    for (int i = optind; i < argc || (i == optind && optind == argc && num_sources == 0); i++) {
+        if (num_panels == MAX_PANELS) {
+            fprintf(stderr, "Too many inputs, at most %d are supported!\n", MAX_PANELS);
+            return 1;
+        }
+        Panel *panel = &panels[num_panels++];
+        panel->kind = PANEL_TRACE;
+        panel->input = INPUT_FILE;
+        panel->path = (optind == argc) ? "-" : argv[i];
+        panel->fd = -1;
+        panel->listen_fd = -1;
+        panel->scale = 1.0f;
+        panel->zoom = 1.0f;
+    }
+    int num_inputs = num_panels;
+
+    // Allocate the retained history of every input; its pages are only touched as samples arrive
+    for (int i = 0; i < num_inputs; i++) {
+        panels[i].history = malloc(history_size * sizeof(float));
+        panels[i].history_lows = malloc(history_size * sizeof(float));
+        panels[i].history_highs = malloc(history_size * sizeof(float));
+        if (panels[i].history == NULL || panels[i].history_lows == NULL || panels[i].history_highs == NULL) {
+            fprintf(stderr, "Failed to allocate a history of %d samples!\n", history_size);
+            return 1;
+        }
+    }
+
+    // Create one spectrum panel per requested channel, after the trace panels, fed by the samples of that channel
+    for (int i = 0; i < num_spectra; i++) {
+        int channel = spectrum_channels[i];
+        if (channel < 0 || channel >= num_inputs || panels[channel].spectrum != NULL || num_panels == MAX_PANELS) {
+            fprintf(stderr, "Invalid spectrum channel %d!\n", channel);
+            return 1;
+        }
+        Panel *panel = &panels[num_panels++];
+        panel->kind = PANEL_SPECTRUM;
+        panel->fd = -1;
+        panel->listen_fd = -1;
+        panel->spectrum = spectrum_create(fft_size, fft_hop);
+        panels[channel].spectrum = panel->spectrum;
+    }
+
+    // Attach the alarm rules to their channels and start the alarm log
+    for (int i = 0; i < num_alarms; i++) {
+        int channel = alarm_rules[i].channel;
+        if (channel < 0 || channel >= num_inputs) {
+            fprintf(stderr, "Invalid alarm channel %d!\n", channel);
+            return 1;
+        }
+        panels[channel].has_alarms = 1;
+        panels[channel].alarm_values[0] = NAN;
+    }
+    if (num_alarms > 0 && !alarm_start(alarm_path)) return 1;
+
+    // Start tracing
+    if (trace_path != NULL && !trace_open(trace_path)) return 1;
+
+    // Create the epoll instance and open the inputs
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        fprintf(stderr, "Failed to create epoll instance: %s\n", strerror(errno));
+        return 1;
+    }
+    for (int i = 0; i < num_inputs; i++) {
+        if (!open_input(&panels[i])) return 1;
+    }
+
     // Declare a window and a renderer
     SDL_Window *window = NULL;
     SDL_Renderer *renderer = NULL;
@@ -223,19 +2553,44 @@ int main(int argc, char *argv[]) {
     int width = WINDOW_WIDTH;
     int height = WINDOW_HEIGHT;
 
-    // Get the initial window size and resize the points array accordingly
+    // Get the initial window size and lay out the panels accordingly
     SDL_GetWindowSize(window, &width, &height);
-    resize_points(width, height);
+    strips[0].renderer = renderer;
 
-    // Declare a variable to store the user input
-    float value = 0.0f; // Changed from int to float
+    // Rasterize in software when the renderer is not accelerated: drawing into one streaming texture is much cheaper than
+    // sending every line and rectangle through SDL's generic software primitives
+    // The software rasterizer splits the window into vertical strips drawn in parallel, one per CPU unless -j says otherwise
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0 && !(info.flags & SDL_RENDERER_ACCELERATED)) software_raster = 1;
+    if (software_raster && !start_strips(raster_threads > 0 ? raster_threads : SDL_GetCPUCount())) {
+        close_sdl(window, renderer);
+        return 1;
+    }
+    if (persistence) phosphor_init();
+    if (!font_init(renderer, software_raster)) {
+        stop_strips();
+        close_sdl(window, renderer);
+        return 1;
+    }
+    layout_panels(width, height);
+    if (software_raster && !create_framebuffer(renderer, width, height)) {
+        stop_strips();
+        close_sdl(window, renderer);
+        return 1;
+    }
 
     // Declare a variable to store the quit flag
     int quit = 0;
 
+    // Declare a variable to store the time of the last present
+    Uint32 last_present = 0;
+
     // Declare an event structure to handle user events
     SDL_Event e;
 
+    // Declare an array to receive the ready inputs from epoll
+    struct epoll_event ready[MAX_PANELS];
+
     // Enter the main loop
     while (!quit) {
         // Handle user events
@@ -244,69 +2599,182 @@ int main(int argc, char *argv[]) {
             if (e.type == SDL_QUIT) {
                 quit = 1;
             }
-            // If the user resizes the window, get the new window size and resize the points array and redraw the graph accordingly
+            // If the user resizes the window, get the new window size and lay out the panels again
             else if (e.type == SDL_WINDOWEVENT && (e.window.event == SDL_WINDOWEVENT_RESIZED || e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)) {
                 SDL_GetWindowSize(window, &width, &height);
-                resize_points(width, height);
-                draw_graph(renderer, width, height);
+                layout_panels(width, height);
+                if (software_raster && !create_framebuffer(renderer, width, height)) quit = 1;
             }
-            // If the user moves the mouse wheel, check if it is over one of the sliders and adjust the offset or scale factor accordingly
+            // If the user moves the mouse wheel, check if it is over one of the sliders of a panel and adjust its offset or zoom accordingly
             else if (e.type == SDL_MOUSEWHEEL) {
-                // Get the mouse position
+                // Get the mouse position and the panel under it
                 int x, y;
                 SDL_GetMouseState(&x, &y);
+                Panel *panel = panel_at(x, y);
+                if (panel == NULL) continue;
+
+                // Use coordinates relative to the panel
+                x -= panel->rect.x;
+                y -= panel->rect.y;
+                int w = panel->rect.w;
+                int h = panel->rect.h;
 
                 // Check if the mouse is over the offset slider
-                if (x >= SLIDER_PADDING && x <= width - SLIDER_PADDING && y >= height - SLIDER_WIDTH - SLIDER_PADDING && y <= height - SLIDER_PADDING) {
+                if (x >= SLIDER_PADDING && x <= w - SLIDER_PADDING && y >= h - SLIDER_WIDTH - SLIDER_PADDING && y <= h - SLIDER_PADDING) {
                     // Set the active slider to 1
-                    active_slider = 1;
+                    panel->active_slider = 1;
 
                     // Adjust the offset by adding or subtracting 10 pixels depending on the mouse wheel direction
                     if (e.wheel.y > 0) {
-                        offset += 10.0f;
+                        panel->offset += 10.0f;
                     }
                     else if (e.wheel.y < 0) {
-                        offset -= 10.0f;
+                        panel->offset -= 10.0f;
                     }
-
-                    // Redraw the graph with the new offset
-                    draw_graph(renderer, width, height);
                 }
                 // Check if the mouse is over the zoom slider
-                else if (x >= width - SLIDER_WIDTH - SLIDER_PADDING && x <= width - SLIDER_PADDING && y >= SLIDER_PADDING && y <= height - SLIDER_WIDTH - SLIDER_PADDING * 3) {
+                else if (x >= w - SLIDER_WIDTH - SLIDER_PADDING && x <= w - SLIDER_PADDING && y >= SLIDER_PADDING && y <= h - SLIDER_WIDTH - SLIDER_PADDING * 3) {
                     // Set the active slider to 2
-                    active_slider = 2;
+                    panel->active_slider = 2;
 
-                    // Adjust the scale factor by multiplying or dividing by 1.1 depending on the mouse wheel direction
+                    // Adjust the zoom factor by multiplying or dividing by 1.1 depending on the mouse wheel direction
                     if (e.wheel.y > 0) {
-                        scale *= 1.1f;
+                        panel->zoom *= 1.1f;
                     }
                     else if (e.wheel.y < 0) {
-                        scale /= 1.1f;
+                        panel->zoom /= 1.1f;
                     }
-
-                    // Redraw the graph with the new scale factor
-                    draw_graph(renderer, width, height);
                 }
-                // Otherwise, set the active slider to 0
+                // Otherwise, set the active slider to 0 and, while paused, pan the views back in time when scrolling up
                 else {
-                    active_slider = 0;
+                    panel->active_slider = 0;
+                    for (int i = 0; paused && i < num_panels; i++) {
+                        if (panels[i].kind == PANEL_TRACE) pan_view(&panels[i], -(long)e.wheel.y * ((panels[i].num_points + PAN_STEPS - 1) / PAN_STEPS));
+                    }
+                }
+
+                // Redraw the panel with the new offset or zoom factor
+                panel->dirty = 1;
+            }
+            // If the user moves the mouse, move the cursor readout to the trace panel and column under it
+            // Dragging with the left button pans the views of paused panels along with the mouse, one sample per column
+            else if (e.type == SDL_MOUSEMOTION) {
+                Panel *panel = panel_at(e.motion.x, e.motion.y);
+                for (int i = 0; paused && (e.motion.state & SDL_BUTTON_LMASK) && i < num_panels; i++) {
+                    if (panels[i].kind == PANEL_TRACE) pan_view(&panels[i], -(long)e.motion.xrel);
+                }
+                if (hover_panel != NULL) hover_panel->dirty = 1;
+                hover_panel = panel;
+                hover_x = panel != NULL ? e.motion.x - panel->rect.x : -1;
+                if (panel != NULL) panel->dirty = 1;
+            }
+            // If the mouse leaves the window, remove the cursor readout
+            else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_LEAVE) {
+                if (hover_panel != NULL) hover_panel->dirty = 1;
+                hover_panel = NULL;
+                hover_x = -1;
+            }
+            // If the user presses S, toggle the statistics overlay of all panels
+            else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_s) {
+                show_stats = !show_stats;
+                for (int i = 0; i < num_panels; i++) {
+                    panels[i].dirty = 1;
+                }
+            }
+            // If the user presses space, freeze the trace panels at their newest samples, or return them to live
+            else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_SPACE) {
+                set_paused(!paused);
+            }
+            // If the user presses an arrow key, Page Up or Page Down, Home or End, pause if needed and pan the views through the history:
+            // by a step, by a whole panel, or to the oldest or the newest retained samples
+            else if (e.type == SDL_KEYDOWN && (e.key.keysym.sym == SDLK_LEFT || e.key.keysym.sym == SDLK_RIGHT || e.key.keysym.sym == SDLK_PAGEUP ||
+                                               e.key.keysym.sym == SDLK_PAGEDOWN || e.key.keysym.sym == SDLK_HOME || e.key.keysym.sym == SDLK_END)) {
+                set_paused(1);
+                for (int i = 0; i < num_panels; i++) {
+                    if (panels[i].kind != PANEL_TRACE) continue;
+                    long step = (panels[i].num_points + PAN_STEPS - 1) / PAN_STEPS;
+                    switch (e.key.keysym.sym) {
+                        case SDLK_LEFT: pan_view(&panels[i], -step); break;
+                        case SDLK_RIGHT: pan_view(&panels[i], step); break;
+                        case SDLK_PAGEUP: pan_view(&panels[i], -panels[i].num_points); break;
+                        case SDLK_PAGEDOWN: pan_view(&panels[i], panels[i].num_points); break;
+                        case SDLK_HOME: pan_view(&panels[i], -history_size); break;
+                        default: pan_view(&panels[i], history_size); break;
+                    }
                 }
             }
+            // If the user presses P, switch between the persistence display and the trace
+            // The hit counts keep growing without fading out while the trace is shown, so the display starts over
+            else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_p && persistence) {
+                show_persistence = !show_persistence;
+                for (int i = 0; i < num_panels; i++) {
+                    phosphor_clear(&panels[i]);
+                    panels[i].dirty = 1;
+                }
+            }
+        }
+
+        // Wait for input until the next frame is due (or for a whole frame interval if nothing needs drawing),
+        // without waiting if a regular file still has data
+        int busy = 0;
+        int dirty = 0;
+        for (int i = 0; i < num_panels; i++) {
+            if (panels[i].fd != -1 && !panels[i].pollable) busy = 1;
+            dirty |= panels[i].dirty;
+        }
+        int timeout = dirty ? FRAME_INTERVAL - (int)(SDL_GetTicks() - last_present) : FRAME_INTERVAL;
+        if (busy || timeout < 0) timeout = 0;
+        int count = epoll_wait(epoll_fd, ready, MAX_PANELS, timeout);
+
+        // Read the inputs that have data
+        for (int i = 0; i < count; i++) {
+            Panel *panel = &panels[ready[i].data.u64 >> 1];
+            if (ready[i].data.u64 & 1) {
+                accept_input(panel);
+            }
+            else if (panel->fd != -1) {
+                read_input(panel);
+            }
         }
+        for (int i = 0; i < num_panels; i++) {
+            if (panels[i].fd != -1 && !panels[i].pollable) read_input(&panels[i]);
+        }
+
+        // Draw all panels with a single present once per frame interval, if any of them changed
+        // Spectrum panels change when their worker published a new spectrum, unless they are frozen
+        dirty = 0;
+        for (int i = 0; i < num_panels; i++) {
+            if (panels[i].kind == PANEL_SPECTRUM && !paused && spectrum_fetch(panels[i].spectrum)) panels[i].dirty = 1;
+            if (panels[i].hits != NULL && show_persistence && !paused) panels[i].dirty = 1; // Keep fading out
+            dirty |= panels[i].dirty;
+        }
+        if (dirty && SDL_GetTicks() - last_present >= FRAME_INTERVAL) {
+            draw_panels(renderer);
+            last_present = SDL_GetTicks();
+        }
+    }
 
-        // Read a value from the standard input
-        value = read_value();
+    // Stop the FFT workers and the raster workers
+    for (int i = 0; i < num_panels; i++) {
+        if (panels[i].kind == PANEL_SPECTRUM) spectrum_destroy(panels[i].spectrum);
+    }
+    stop_strips();
 
-        // If the value is valid, update the points array and draw the graph
-        if (value >= 0.0f) { // Changed from int to float comparison
-            update_points(value, width, height);
-            draw_graph(renderer, width, height);
+    // Report the counters of the datagram sockets
+    for (int i = 0; i < num_panels; i++) {
+        if (panels[i].input == INPUT_UDP || panels[i].input == INPUT_UNIX_DGRAM) {
+            fprintf(stderr, "%s %s: %lu datagrams, %lu truncated, %lu dropped\n", panels[i].input == INPUT_UDP ? "udp" : "unix-dgram", panels[i].path, panels[i].datagrams, panels[i].truncated, panels[i].dropped);
         }
     }
 
+    // Finish the trace file and print the latency histograms
+    if (trace_file != NULL) trace_close();
+
+    // Write the remaining alarm events and close the alarm log
+    if (num_alarms > 0) alarm_stop();
+
     // Close the SDL library and destroy the window and the renderer
-    close(window, renderer);
+    close_sdl(window, renderer);
 
     // Return success
     return 0;
@@ -0,0 +1,322 @@
+// Include the necessary headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <pty.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// Define some constants
+#define BENCH_RATE 100000 // The default byte rate written to the pseudo-terminal (bytes per second)
+#define BENCH_DURATION 5.0 // The default duration of the benchmark in seconds
+#define BENCH_PERIOD 1000 // The default period of the waveform in samples
+#define BENCH_BAUD "115200" // The baud rate passed to the program under test (ignored by pseudo-terminals)
+#define HELPER_PATH "./serial_helper_2" // The default helper binary
+#define GRAPHER_PATH "./rolling_graph_5" // The default grapher binary
+#define CHUNK 4096 // The largest number of bytes written or read at once
+#define DRAIN_TIMEOUT 2.0 // The time in seconds without output after which the helper's output is no longer waited for
+
+// An enumeration of the programs that can be benchmarked
+enum { MODE_HELPER, MODE_GRAPHER, MODE_NONE };
+
+// An enumeration of the output formats
+enum { FORMAT_PLAIN, FORMAT_SEQ };
+
+// Declare some global variables to store the benchmark parameters
+long byte_rate = BENCH_RATE; // The byte rate to write, 0 for as fast as the reader accepts
+double duration = BENCH_DURATION; // The duration of the benchmark in seconds
+int period = BENCH_PERIOD; // The period of the waveform in samples
+char waveform = 's'; // The waveform: s(ine), q(uare), t(riangle/saw) or n(oise)
+int format = FORMAT_SEQ; // The output format
+int mode = MODE_HELPER; // The program under test
+const char *program = NULL; // The path of the program under test
+
+// Declare some global variables to store the counters of the run
+unsigned long samples_made = 0; // The number of samples formatted into the output buffer
+unsigned long samples_sent = 0; // The number of samples whose whole line was written to the pseudo-terminal
+unsigned long bytes_sent = 0; // The number of bytes written to the pseudo-terminal
+unsigned long samples_received = 0; // The number of samples read back from the helper
+unsigned long samples_missing = 0; // The number of sequence numbers skipped in the helper output
+unsigned long samples_reordered = 0; // The number of sequence numbers that went backwards or repeated
+unsigned long next_seq = 0; // The sequence number expected next from the helper
+double last_output = 0.0; // The time the helper's output was last read
+
+// Declare some global buffers to store the pending output to the pseudo-terminal and the incomplete line of input
+char out[CHUNK];
+int out_len = 0;
+char in[CHUNK + 1];
+int in_len = 0;
+
+// A function to get the current monotonic time in seconds
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// A function to get the value of the synthetic waveform for a sample number
+double wave(unsigned long n) {
+    double phase = (double)(n % period) / period;
+    switch (waveform) {
+        case 'q': return phase < 0.5 ? 1.0 : -1.0;
+        case 't': return 2.0 * phase - 1.0;
+        case 'n': return 2.0 * rand() / RAND_MAX - 1.0;
+        default: return sin(2.0 * M_PI * phase);
+    }
+}
+
+// A function to format the next sample into a buffer, returning its length
+int format_sample(char *buffer, size_t size) {
+    double value = wave(samples_made);
+    if (format == FORMAT_SEQ) {
+        return snprintf(buffer, size, "%.6f,%lu\n", value, samples_made);
+    }
+    return snprintf(buffer, size, "%.6f\n", value);
+}
+
+// A function to check the sequence number of a line read back from the helper
+void check_line(const char *line) {
+    // Count the sample and find its sequence number after the comma
+    samples_received++;
+    const char *comma = strchr(line, ',');
+    if (comma == NULL) return;
+    unsigned long seq = strtoul(comma + 1, NULL, 10);
+
+    // Count the missing sequence numbers, or the ones out of order
+    if (seq >= next_seq) {
+        samples_missing += seq - next_seq;
+        next_seq = seq + 1;
+    }
+    else {
+        samples_reordered++;
+    }
+}
+
+// A function to start the program under test on the slave side of the pseudo-terminal, with its output on a pipe
+pid_t start_program(const char *slave, int *output) {
+    // Create the pipe for the output of the program
+    int fds[2];
+    if (pipe(fds) != 0) {
+        fprintf(stderr, "Failed to create pipe: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Fork and run the program with the slave as its serial device
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        if (mode == MODE_HELPER) {
+            execl(program, program, "-d", slave, "-b", BENCH_BAUD, (char *)NULL);
+        }
+        else {
+            execl(program, program, "--serial", slave, "--baud", BENCH_BAUD, (char *)NULL);
+        }
+        fprintf(stderr, "Failed to run %s: %s\n", program, strerror(errno));
+        _exit(127);
+    }
+    close(fds[1]);
+    if (pid == -1) {
+        fprintf(stderr, "Failed to fork: %s\n", strerror(errno));
+        close(fds[0]);
+        return -1;
+    }
+
+    // Return the pid of the program and the read end of its output
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    *output = fds[0];
+    return pid;
+}
+
+// A function to write as much of the pending output as the pseudo-terminal accepts
+// A sample counts as sent once the newline ending it is written
+void write_output(int master) {
+    ssize_t bytes = write(master, out, out_len);
+    if (bytes <= 0) return;
+    bytes_sent += bytes;
+    for (ssize_t i = 0; i < bytes; i++) samples_sent += out[i] == '\n';
+    memmove(out, out + bytes, out_len - bytes);
+    out_len -= bytes;
+}
+
+// A function to read what the program under test wrote back and check every complete line, returning 0 once it exited
+int read_output(int output) {
+    ssize_t bytes = read(output, in + in_len, CHUNK - in_len);
+    if (bytes == 0) return 0;
+    if (bytes < 0) return 1;
+    last_output = now();
+    in_len += bytes;
+    in[in_len] = '\0';
+    char *line = in;
+    char *newline;
+    while ((newline = strchr(line, '\n')) != NULL) {
+        *newline = '\0';
+        check_line(line);
+        line = newline + 1;
+    }
+    in_len -= line - in;
+    if (in_len == CHUNK) in_len = 0;
+    memmove(in, line, in_len);
+    return 1;
+}
+
+// The main function of the program
+int main(int argc, char *argv[]) {
+    // Declare a variable to store the option character
+    int opt;
+
+    // Parse the command line arguments using getopt
+    while ((opt = getopt(argc, argv, "r:t:p:w:f:m:x:")) != -1) {
+        switch (opt) {
+            case 'r': // Byte rate option
+                byte_rate = atol(optarg);
+                break;
+            case 't': // Duration option
+                duration = atof(optarg);
+                break;
+            case 'p': // Waveform period option
+                period = atoi(optarg) > 0 ? atoi(optarg) : BENCH_PERIOD;
+                break;
+            case 'w': // Waveform option
+                waveform = optarg[0];
+                break;
+            case 'f': // Format option
+                format = strcmp(optarg, "plain") == 0 ? FORMAT_PLAIN : FORMAT_SEQ;
+                break;
+            case 'm': // Mode option
+                mode = strcmp(optarg, "grapher") == 0 ? MODE_GRAPHER : strcmp(optarg, "none") == 0 ? MODE_NONE : MODE_HELPER;
+                break;
+            case 'x': // Program path option
+                program = optarg;
+                break;
+            default: // Invalid option or missing argument
+                fprintf(stderr, "Usage: %s [-m helper|grapher|none] [-x program] [-r bytes_per_s] [-t seconds] [-w s|q|t|n] [-p period] [-f seq|plain]\n", argv[0]); // Print usage message and exit
+                return 1;
+        }
+    }
+    if (program == NULL) program = (mode == MODE_GRAPHER) ? GRAPHER_PATH : HELPER_PATH;
+
+    // Create the pseudo-terminal pair and put the slave side in raw mode, so that nothing is echoed or translated
+    int master, slave;
+    char slave_name[256];
+    if (openpty(&master, &slave, slave_name, NULL, NULL) != 0) {
+        fprintf(stderr, "Failed to create pseudo-terminal: %s\n", strerror(errno));
+        return 1;
+    }
+    struct termios config;
+    tcgetattr(slave, &config);
+    cfmakeraw(&config);
+    tcsetattr(slave, TCSANOW, &config);
+    fcntl(master, F_SETFD, FD_CLOEXEC);
+    fcntl(slave, F_SETFD, FD_CLOEXEC);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+
+    // Start the program under test, or just announce the slave side for a program started by hand
+    int output = -1;
+    pid_t pid = -1;
+    if (mode == MODE_NONE) {
+        fprintf(stderr, "Writing to %s\n", slave_name);
+    }
+    else {
+        pid = start_program(slave_name, &output);
+        if (pid == -1) return 1;
+    }
+
+    // Ignore the broken pipe signal so that a dead program shows up as an error
+    signal(SIGPIPE, SIG_IGN);
+
+    // Write the waveform at the requested rate and check what comes back, until the duration is over
+    double start = now();
+    double elapsed = 0.0;
+    int exited = 0;
+    while ((elapsed = now() - start) < duration) {
+        // Fill the output buffer with whole samples up to the byte count that is due
+        long due = byte_rate > 0 ? (long)(byte_rate * elapsed) - (long)bytes_sent : CHUNK;
+        while (out_len < (int)sizeof(out) - 64 && due > out_len) {
+            out_len += format_sample(out + out_len, sizeof(out) - out_len);
+            samples_made++;
+        }
+
+        // Wait until the master side accepts data, the program has output, or the next byte is due
+        struct pollfd fds[2] = {{master, out_len > 0 ? POLLOUT : 0, 0}, {output, POLLIN, 0}};
+        poll(fds, output == -1 ? 1 : 2, 1);
+
+        // Write as much of the pending output as the pseudo-terminal accepts, and check what the program wrote back
+        if (out_len > 0 && (fds[0].revents & POLLOUT)) write_output(master);
+        if (output != -1 && (fds[1].revents & (POLLIN | POLLHUP)) && !read_output(output)) {
+            fprintf(stderr, "%s exited early\n", program);
+            exited = 1;
+            break;
+        }
+    }
+
+    // Finish writing the samples already formatted, then drain the helper's output until the last sequence number
+    // (or every line) came back, or until it stays silent for DRAIN_TIMEOUT, so that samples in flight are not miscounted
+    // The grapher has no output to drain; it is only given the time to take in what was written
+    double drain_start = now();
+    last_output = drain_start;
+    while (!exited && mode != MODE_NONE && now() - last_output < DRAIN_TIMEOUT) {
+        if (mode == MODE_HELPER && out_len == 0 && (format == FORMAT_SEQ ? next_seq >= samples_sent : samples_received >= samples_sent)) break;
+        if (mode == MODE_GRAPHER && out_len == 0) break;
+        struct pollfd fds[2] = {{master, out_len > 0 ? POLLOUT : 0, 0}, {output, POLLIN, 0}};
+        poll(fds, 2, 10);
+        if (out_len > 0 && (fds[0].revents & POLLOUT)) {
+            write_output(master);
+            last_output = now();
+        }
+        if ((fds[1].revents & (POLLIN | POLLHUP)) && !read_output(output)) break;
+    }
+    double drained = now() - drain_start;
+
+    // Stop the program under test and collect its CPU time
+    struct rusage usage;
+    memset(&usage, 0, sizeof(usage));
+    if (pid != -1) {
+        kill(pid, SIGTERM);
+        wait4(pid, NULL, 0, &usage);
+    }
+    struct rusage self;
+    getrusage(RUSAGE_SELF, &self);
+    double program_cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    double bench_cpu = self.ru_utime.tv_sec + self.ru_utime.tv_usec / 1e6 + self.ru_stime.tv_sec + self.ru_stime.tv_usec / 1e6;
+
+    // Report the throughput, the CPU cost per sample and the data loss
+    // The helper's output is checked sample by sample, and every sample sent but not received back counts as lost
+    // The grapher has no output to check, so only the rate it was offered and its CPU time per sample sent are known
+    unsigned long samples = (mode == MODE_HELPER) ? samples_received : samples_sent;
+    unsigned long samples_lost = samples_sent > samples_received ? samples_sent - samples_received : 0;
+    printf("program:        %s\n", mode == MODE_NONE ? "(none)" : program);
+    printf("duration:       %.3f s (+%.3f s drain)\n", elapsed, drained);
+    printf("sent:           %lu samples, %lu bytes (%.0f bytes/s)\n", samples_sent, bytes_sent, bytes_sent / elapsed);
+    if (mode == MODE_HELPER) {
+        printf("received:       %lu samples\n", samples_received);
+        printf("lost:           %lu samples (%.4f%%)", samples_lost, samples_sent ? 100.0 * samples_lost / samples_sent : 0.0);
+        if (format == FORMAT_SEQ) printf(", %lu skipped in sequence, %lu out of order", samples_missing, samples_reordered);
+        printf("\n");
+        printf("sustained:      %.0f samples/s\n", samples / (elapsed + drained));
+    }
+    else {
+        printf("offered:        %.0f samples/s (the rate sent, not a measure of what the program consumed)\n", samples_sent / elapsed);
+    }
+    if (pid != -1 && samples > 0) {
+        printf("program CPU:    %.3f s (%.0f ns/sample)\n", program_cpu, program_cpu * 1e9 / samples);
+    }
+    printf("bench CPU:      %.3f s\n", bench_cpu);
+
+    // Close the pseudo-terminal and the pipe
+    close(master);
+    close(slave);
+    if (output != -1) close(output);
+
+    // Return success
+    return 0;
+}
@@ -0,0 +1,80 @@
+// The serial port setup shared by the helper and the grapher, which both read serial ports directly
+#ifndef SERIAL_CONFIG_H
+#define SERIAL_CONFIG_H
+
+// Include the necessary headers
+#include <stdio.h>
+#include <stddef.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// A function to map a baud rate in bits per second to its termios speed constant, returning B0 if it has none
+static speed_t baud_to_speed(int rate) {
+    static const struct { int rate; speed_t speed; } rates[] = {
+        {50, B50}, {75, B75}, {110, B110}, {134, B134}, {150, B150}, {200, B200}, {300, B300}, {600, B600},
+        {1200, B1200}, {1800, B1800}, {2400, B2400}, {4800, B4800}, {9600, B9600}, {19200, B19200}, {38400, B38400},
+        {57600, B57600}, {115200, B115200}, {230400, B230400},
+#ifdef B460800
+        {460800, B460800}, {500000, B500000}, {576000, B576000}, {921600, B921600}, {1000000, B1000000},
+        {1152000, B1152000}, {1500000, B1500000}, {2000000, B2000000}, {2500000, B2500000}, {3000000, B3000000},
+        {3500000, B3500000}, {4000000, B4000000},
+#endif
+    };
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (rates[i].rate == rate) return rates[i].speed;
+    }
+    return B0;
+}
+
+// A function to initialize the serial port with the given device file and baud rate
+static int init_serial(const char *device, speed_t baud) {
+    // Open the device file in read-write mode, without controlling terminal, and non-blocking
+    int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd == -1) {
+        fprintf(stderr, "Failed to open %s\n", device);
+        return -1;
+    }
+
+    // Get the current configuration of the serial interface
+    struct termios config;
+    if (tcgetattr(fd, &config) != 0) {
+        fprintf(stderr, "Failed to get configuration of %s\n", device);
+        close(fd);
+        return -1;
+    }
+
+    // Set the input and output baud rates
+    if (cfsetispeed(&config, baud) != 0 || cfsetospeed(&config, baud) != 0) {
+        fprintf(stderr, "Failed to set baud rate of %s\n", device);
+        close(fd);
+        return -1;
+    }
+
+    // Set the other configuration flags
+    config.c_cflag |= (CLOCAL | CREAD); // Enable the receiver and set local mode
+    config.c_cflag &= ~PARENB; // No parity bit
+    config.c_cflag &= ~CSTOPB; // 1 stop bit
+    config.c_cflag &= ~CSIZE; // Mask the character size bits
+    config.c_cflag |= CS8; // 8 data bits
+    config.c_cflag &= ~CRTSCTS; // Disable hardware flow control
+
+    config.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG); // Enable raw input
+
+    config.c_iflag &= ~(IXON | IXOFF | IXANY); // Disable software flow control
+    config.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL); // Disable special handling of received bytes
+
+    config.c_oflag &= ~OPOST; // Enable raw output
+
+    // Set the new configuration of the serial interface
+    if (tcsetattr(fd, TCSANOW, &config) != 0) {
+        fprintf(stderr, "Failed to set configuration of %s\n", device);
+        close(fd);
+        return -1;
+    }
+
+    // Return the file descriptor
+    return fd;
+}
+
+#endif // SERIAL_CONFIG_H
@@ -3,9 +3,13 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <event.h>
+#include <event2/thread.h>
 #include <termios.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include "serial_config.h"
 
 // Define some constants
 #define SERIAL_PORT "/dev/ttyS0" // The default serial port device file
@@ -22,54 +26,79 @@ struct event_base *evbase;
 // Declare a global variable to store the serial port file descriptor
 int serial_fd;
 
-// A function to initialize the serial port with the given device file and baud rate
-int init_serial(const char *device, speed_t baud) {
-    // Open the device file in read-write mode, without controlling terminal, and non-blocking
-    int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (fd == -1) {
-        fprintf(stderr, "Failed to open %s\n", device);
-        return -1;
-    }
+// Declare a global variable to store whether each block of complete lines is preceded by a "#t <ns>" read timestamp line
+int trace = 0;
 
-    // Get the current configuration of the serial interface
-    struct termios config;
-    if (tcgetattr(fd, &config) != 0) {
-        fprintf(stderr, "Failed to get configuration of %s\n", device);
-        close(fd);
-        return -1;
-    }
+// Declare a global buffer to store the incomplete last line of the previous read when tracing
+char trace_pending[SERIAL_BUFFER];
 
-    // Set the input and output baud rates
-    if (cfsetispeed(&config, baud) != 0 || cfsetospeed(&config, baud) != 0) {
-        fprintf(stderr, "Failed to set baud rate of %s\n", device);
-        close(fd);
-        return -1;
-    }
+// Declare a global variable to store the number of bytes in the incomplete line buffer
+int trace_pending_len = 0;
 
-    // Set the other configuration flags
-    config.c_cflag |= (CLOCAL | CREAD); // Enable the receiver and set local mode
-    config.c_cflag &= ~PARENB; // No parity bit
-    config.c_cflag &= ~CSTOPB; // 1 stop bit
-    config.c_cflag &= ~CSIZE; // Mask the character size bits
-    config.c_cflag |= CS8; // 8 data bits
-    config.c_cflag &= ~CRTSCTS; // Disable hardware flow control
+// Declare a global variable to store the number of aggregated blocks written per second (0 to pass the data through unchanged)
+double aggregate_rate = 0.0;
 
-    config.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG); // Enable raw input
+// Declare some global variables to store the block of samples being aggregated
+float block_min = 0.0f; // The smallest sample of the block
+float block_max = 0.0f; // The largest sample of the block
+double block_sum = 0.0; // The sum of the samples of the block
+long block_count = 0; // The number of samples in the block
+long long block_stamp = 0; // The read time of the first sample of the block, in nanoseconds of the monotonic clock
 
-    config.c_iflag &= ~(IXON | IXOFF | IXANY); // Disable software flow control
-    config.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL); // Disable special handling of received bytes
+// Declare a global buffer to store the incomplete last line of the previous read when aggregating
+char line_pending[SERIAL_BUFFER];
 
-    config.c_oflag &= ~OPOST; // Enable raw output
+// Declare a global variable to store the number of bytes in the incomplete line buffer when aggregating
+int line_pending_len = 0;
+
+// Declare a global variable to store the file descriptor the raw data is copied to (-1 if none)
+int raw_fd = -1;
+
+// A function to add one line of text to the block being aggregated, if it starts with a number
+void aggregate_line(const char *line, long long stamp) {
+    char *end;
+    float value = strtof(line, &end);
+    if (end == line || value != value) return;
+    if (block_count == 0) {
+        block_min = block_max = value;
+        block_sum = 0.0;
+        block_stamp = stamp;
+    }
+    if (value < block_min) block_min = value;
+    if (value > block_max) block_max = value;
+    block_sum += value;
+    block_count++;
+}
 
-    // Set the new configuration of the serial interface
-    if (tcsetattr(fd, TCSANOW, &config) != 0) {
-        fprintf(stderr, "Failed to set configuration of %s\n", device);
-        close(fd);
-        return -1;
+// A function to split the data read from the serial port into lines and aggregate them, holding back the incomplete last line
+void aggregate_data(const char *data, int bytes, long long stamp) {
+    for (int i = 0; i < bytes; i++) {
+        if (data[i] != '\n') {
+            if (line_pending_len < SERIAL_BUFFER - 1) line_pending[line_pending_len++] = data[i];
+            continue;
+        }
+        line_pending[line_pending_len] = '\0';
+        aggregate_line(line_pending, stamp);
+        line_pending_len = 0;
     }
+}
 
-    // Return the file descriptor
-    return fd;
+// A function to write the aggregated block to standard output as a "#b min,max,mean,count" line and start a new block
+// The "#b" marker keeps the grapher from taking ordinary CSV lines with several columns for blocks
+// When tracing, the line is preceded by the read time of the first sample of the block
+void write_block(int fd, short events, void *arg) {
+    (void)fd;
+    (void)events;
+    (void)arg;
+    if (block_count == 0) return;
+    char out[128];
+    int len = 0;
+    if (trace) len = snprintf(out, sizeof(out), "#t %lld\n", block_stamp);
+    len += snprintf(out + len, sizeof(out) - len, "#b %.7g,%.7g,%.7g,%ld\n", block_min, block_max, block_sum / block_count, block_count);
+    block_count = 0;
+    if (write(STDOUT_FILENO, out, len) <= 0) {
+        fprintf(stderr, "Failed to write to standard output\n");
+    }
 }
 
 // A function to read data from the serial port and write it to standard output
@@ -86,8 +115,54 @@ void read_serial(int fd, short events, void *arg) {
         return;
     }
 
-    // Write data to standard output
-    bytes = write(STDOUT_FILENO, buffer, bytes);
+    // Copy the data unchanged to the raw output, if any
+    if (raw_fd != -1 && write(raw_fd, buffer, bytes) != bytes) {
+        fprintf(stderr, "Failed to write to raw output\n");
+    }
+
+    // When aggregating, only add the samples to the current block, which the timer writes out
+    if (aggregate_rate > 0.0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        aggregate_data(buffer, bytes, ts.tv_sec * 1000000000LL + ts.tv_nsec);
+        return;
+    }
+
+    // When tracing, stamp the complete lines with the read time of the monotonic clock (shared with the grapher)
+    // The stamp must start a line, so the incomplete last line is held back until the next read completes it
+    if (trace) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        // Find the end of the last complete line, or keep the whole read for later if there is none
+        int complete = bytes;
+        while (complete > 0 && buffer[complete - 1] != '\n') complete--;
+        if (complete == 0 && trace_pending_len + bytes <= SERIAL_BUFFER) {
+            memcpy(trace_pending + trace_pending_len, buffer, bytes);
+            trace_pending_len += bytes;
+            return;
+        }
+
+        // A line too long to hold back is ended here, so that the next stamp still starts a line
+        int overlong = complete == 0;
+        if (overlong) complete = bytes;
+
+        // Write the stamp, the held back line and the complete lines in one write, and hold back the rest
+        char out[SERIAL_BUFFER * 2 + 32];
+        int len = snprintf(out, 32, "#t %lld\n", ts.tv_sec * 1000000000LL + ts.tv_nsec);
+        memcpy(out + len, trace_pending, trace_pending_len);
+        len += trace_pending_len;
+        memcpy(out + len, buffer, complete);
+        len += complete;
+        if (overlong) out[len++] = '\n';
+        trace_pending_len = bytes - complete;
+        memcpy(trace_pending, buffer + complete, trace_pending_len);
+        bytes = write(STDOUT_FILENO, out, len);
+    }
+    else {
+        // Write data to standard output
+        bytes = write(STDOUT_FILENO, buffer, bytes);
+    }
 
      // Check for errors or no data
      if (bytes <= 0) {
@@ -113,11 +188,21 @@ void *serial_thread(void *arg) {
      // Add the event to the event base with no timeout
      event_add(serial_event, NULL);
 
+     // When aggregating, create a timer event that writes out a block at the configured rate
+     struct event *block_event = NULL;
+     if (aggregate_rate > 0.0) {
+         double period = 1.0 / aggregate_rate;
+         struct timeval interval = {(time_t)period, (suseconds_t)((period - (time_t)period) * 1000000)};
+         block_event = event_new(evbase, -1, EV_PERSIST, write_block, NULL);
+         event_add(block_event, &interval);
+     }
+
      // Start the event loop for reading serial data
      event_base_dispatch(evbase);
 
-     // Free the event
+     // Free the events
      event_free(serial_event);
+     if (block_event != NULL) event_free(block_event);
 
      // Close the serial port
      close(serial_fd);
@@ -135,16 +220,33 @@ int main(int argc, char *argv[]) {
     int opt;
 
     // Parse the command line arguments using getopt
-    while ((opt = getopt(argc, argv, "d:b:")) != -1) {
+    while ((opt = getopt(argc, argv, "d:b:ta:r:")) != -1) {
         switch (opt) {
             case 'd': // Device file option
                 serial_device = optarg; // Store the device file name in the global variable
                 break;
             case 'b': // Baud rate option
-                serial_baud = atoi(optarg); // Convert the baud rate string to an integer and store it in the global variable
+                serial_baud = baud_to_speed(atoi(optarg)); // Map the baud rate to its termios speed constant and store it in the global variable
+                if (serial_baud == B0) {
+                    fprintf(stderr, "Unsupported baud rate %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't': // Trace option
+                trace = 1; // Stamp the data with its read time for the grapher's latency tracing
+                break;
+            case 'a': // Aggregate option
+                aggregate_rate = atof(optarg); // Store the number of blocks written per second in the global variable
+                break;
+            case 'r': // Raw output option
+                raw_fd = open(optarg, O_WRONLY | O_CREAT | O_TRUNC, 0644); // Copy the data unchanged to this file or FIFO
+                if (raw_fd == -1) {
+                    fprintf(stderr, "Failed to open %s\n", optarg);
+                    return 1;
+                }
                 break;
             default: // Invalid option or missing argument
-                fprintf(stderr, "Usage: %s [-d device] [-b baud]\n", argv[0]); // Print usage message and exit
+                fprintf(stderr, "Usage: %s [-d device] [-b baud] [-t] [-a blocks_per_s] [-r raw_output]\n", argv[0]); // Print usage message and exit
                 return 1;
         }
     }
@@ -161,8 +263,9 @@ int main(int argc, char *argv[]) {
     // Wait for the thread to finish
     pthread_join(tid, NULL);
 
-    // Free the event base
+    // Free the event base and close the raw output
     event_base_free(evbase);
+    if (raw_fd != -1) close(raw_fd);
 
     // Return success
     return 0;